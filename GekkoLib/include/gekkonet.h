@@ -26,6 +26,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #pragma once
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #else
@@ -61,9 +63,44 @@ typedef enum GekkoSessionType {
     GekkoSpectateSession, // session for spectators watching an active player.
 } GekkoSessionType;
 
+// optional allocator a session makes all of its allocations through, eg. to place every match in its own arena.
+// returned memory has to be aligned for any type. returning NULL is treated as running out of memory.
+typedef struct GekkoAllocator {
+    void* user_data;
+    void* (*alloc)(void* user_data, size_t size);
+    void (*free)(void* user_data, void* ptr);
+} GekkoAllocator;
+
+// the subsystems the memory of a session is accounted to.
+typedef enum GekkoMemoryTag {
+    GekkoMemorySession, // the session itself, players and bookkeeping.
+    GekkoMemoryInput, // input buffers and input queues.
+    GekkoMemoryStorage, // saved gamestates.
+    GekkoMemoryEvents, // game and session event pools.
+    GekkoMemoryNetwork, // addresses, pending packets and serialization buffers.
+    GekkoMemoryCompression, // input compression.
+    GekkoMemoryTagCount
+} GekkoMemoryTag;
+
+typedef struct GekkoMemoryReport {
+    size_t total_bytes;
+    size_t peak_bytes;
+    size_t num_allocations;
+    size_t bytes[GekkoMemoryTagCount];
+    // memory held from the allocator for the zero allocation mode.
+    size_t reserved_bytes;
+    // allocations which reached the allocator after the session started, stays 0 in a healthy zero allocation session.
+    size_t steady_allocations;
+} GekkoMemoryReport;
+
+// called for every allocation reaching the allocator after a zero allocation session started.
+typedef void (*GekkoAllocationHook)(void* user_data, size_t size, GekkoMemoryTag tag);
+
 typedef struct GekkoConfig {
     unsigned char num_players;
     unsigned char max_spectators;
+    // 0 runs the session in lockstep, frames only advance once every input is in and states are
+    // only saved when desync_detection needs their checksums.
     unsigned char input_prediction_window;
     unsigned int spectator_delay;
     unsigned int input_size;
@@ -71,8 +108,33 @@ typedef struct GekkoConfig {
     bool limited_saving;
     bool desync_detection;
     unsigned int check_distance;
+    // preallocate and prefault the session memory on start so updating it doesnt touch the allocator.
+    bool zero_alloc;
+    // additionally lock the session memory into ram, requires zero_alloc.
+    bool lock_memory;
 } GekkoConfig;
 
+// bounds for the adaptive local input delay.
+typedef struct GekkoAdaptiveDelay {
+    unsigned char min_delay;
+    unsigned char max_delay;
+    // the rollback depth in frames the delay is adjusted to stay under.
+    unsigned char target_rollback;
+} GekkoAdaptiveDelay;
+
+// limits for the adaptive runahead.
+typedef struct GekkoAdaptiveRunahead {
+    unsigned char max_runahead;
+    // the microseconds per update the game can spend advancing, saving and loading.
+    unsigned int frame_budget_us;
+} GekkoAdaptiveRunahead;
+
+// bounds for the adaptive input prediction window.
+typedef struct GekkoAdaptivePredictionWindow {
+    unsigned char min_window;
+    unsigned char max_window;
+} GekkoAdaptivePredictionWindow;
+
 typedef enum GekkoPlayerType {
     GekkoLocalPlayer,
     GekkoRemotePlayer,
@@ -108,8 +170,15 @@ typedef enum GekkoGameEventType {
     GekkoLoadEvent
 } GekkoGameEventType;
 
+// the copy of the simulation an event is meant for, see gekko_set_runahead_instance.
+typedef enum GekkoSimInstance {
+    GekkoPrimaryInstance,
+    GekkoRunaheadInstance
+} GekkoSimInstance;
+
 typedef struct GekkoGameEvent {
     GekkoGameEventType type;
+    GekkoSimInstance instance;
 
     union GekkoEventData {
         // events 
@@ -119,6 +188,8 @@ typedef struct GekkoGameEvent {
             unsigned char* inputs;
             bool rolling_back;
             bool running_ahead;
+            // one of several frames a lagging session catches up on within an update, dont render it.
+            bool fast_forward;
         } adv;
         struct GekkoSave {
             int frame;
@@ -134,6 +205,43 @@ typedef struct GekkoGameEvent {
     } data;
 } GekkoGameEvent;
 
+// optional inversion of control for the game events. when set the session calls these
+// directly while it walks the rollback instead of handing out an event array.
+// every callback receives the event it would otherwise have returned, the event is only valid during the call.
+typedef struct GekkoSimCallbacks {
+    void* user_data;
+    void (*advance)(void* user_data, GekkoGameEvent* ev);
+    void (*save)(void* user_data, GekkoGameEvent* ev);
+    void (*load)(void* user_data, GekkoGameEvent* ev);
+} GekkoSimCallbacks;
+
+// a single frame simulated with alternative inputs, only valid during the branch_advance call.
+typedef struct GekkoBranch {
+    int frame;
+    unsigned int input_len;
+    const unsigned char* inputs;
+    // the state the frame starts from.
+    unsigned int state_len;
+    const unsigned char* state;
+    // write the state after the frame here, exactly like the save callback would.
+    unsigned int* out_state_len;
+    unsigned int* out_checksum;
+    unsigned char* out_state;
+} GekkoBranch;
+
+// optional speculation on top of the sim callbacks. for the first frame that was simulated with predicted
+// inputs the session asks the game for alternative inputs and simulates each of them on a worker thread.
+// when the real inputs match one of them that branch is loaded instead of resimulating the frame.
+typedef struct GekkoSpeculationCallbacks {
+    void* user_data;
+    // called on the session thread. write up to max alternative input sets of input_len bytes each into
+    // hypotheses, the predicted inputs are given for reference. returns the number of sets written.
+    int (*hypotheses)(void* user_data, int frame, const unsigned char* predicted, unsigned int input_len, unsigned char* hypotheses, int max);
+    // called from the worker threads concurrently with the session thread and each other,
+    // it may only read and write through the branch and must not touch the running game.
+    void (*branch_advance)(void* user_data, GekkoBranch* branch);
+} GekkoSpeculationCallbacks;
+
 typedef enum GekkoSessionEventType {
     GekkoEmptySessionEvent = -1,
     GekkoPlayerSyncing,
@@ -177,9 +285,25 @@ typedef struct GekkoNetworkStats {
     float jitter;
 } GekkoNetworkStats;
 
+// frame pacing advice, following it lets the peers converge on the same frame timing without skipping frames.
+typedef struct GekkoTimingAdvice {
+    // time in microseconds from now until the next gekko_update_session.
+    unsigned int next_tick_us;
+    // the length of the current frame in microseconds, the measured frame time adjusted by tick_rate_scale.
+    unsigned int frame_time_us;
+    // multiplier for the tick rate, stays within 2% of 1.0. below 1.0 means slowing down.
+    float tick_rate_scale;
+    // the smoothed frames this session is ahead of its peers including the progress into the current frame.
+    float frames_ahead;
+} GekkoTimingAdvice;
+
 // Public Facing API
 GEKKONET_API bool gekko_create(GekkoSession** session, GekkoSessionType session_type);
 
+// same as gekko_create but every allocation the session makes goes through the given allocator.
+// the allocator is copied, passing NULL uses the global heap.
+GEKKONET_API bool gekko_create_with_allocator(GekkoSession** session, GekkoSessionType session_type, GekkoAllocator* allocator);
+
 GEKKONET_API bool gekko_destroy(GekkoSession** session);
 
 GEKKONET_API void gekko_start(GekkoSession* session, GekkoConfig* config);
@@ -199,20 +323,93 @@ GEKKONET_API void gekko_set_disconnect_timeout(GekkoSession* session, unsigned i
 
 GEKKONET_API void gekko_set_local_delay(GekkoSession* session, int player, unsigned char delay);
 
+// lets the session adjust the delay of all local players from the round trip time, jitter, prediction
+// hit rate and rollback depth it measures. passing NULL turns it off and keeps the current delay.
+GEKKONET_API void gekko_set_adaptive_delay(GekkoSession* session, GekkoAdaptiveDelay* settings);
+
 GEKKONET_API void gekko_set_runahead(GekkoSession* session, unsigned char runahead);
 
+// lets the session pick the runahead up to max_runahead so the simulation stays within the budget,
+// runahead is also lowered while predictions fail often. the time spent in the simulation callbacks is
+// measured, without them the game reports it through gekko_report_sim_time. passing NULL turns it off
+// and keeps the current runahead.
+GEKKONET_API void gekko_set_adaptive_runahead(GekkoSession* session, GekkoAdaptiveRunahead* settings);
+
+// the microseconds the game spent handling the game events of the last update.
+GEKKONET_API void gekko_report_sim_time(GekkoSession* session, unsigned int time_us);
+
+// runs the frames ahead on a second copy of the simulation instead of saving and loading the primary one
+// every update. events for it are tagged GekkoRunaheadInstance and only advance and load, the load copies
+// the state of the primary instance over when a prediction broke. while runahead is set the game shows
+// the runahead instance, the primary one only ever simulates the real frames.
+// needs limited_saving turned off.
+GEKKONET_API void gekko_set_runahead_instance(GekkoSession* session, bool enabled);
+
+// lets a session that fell behind its peers advance up to max_frames extra frames per update, as long
+// as every remote input for them is in. the extra frames are flagged fast_forward so the game can skip
+// rendering and audio for them, the local input of the update is repeated for the frames skipped over.
+// 0 turns it off, it doesnt apply with limited_saving.
+GEKKONET_API void gekko_set_catch_up(GekkoSession* session, unsigned char max_frames);
+
+// caps the number of frames a single update resimulates, a deeper rollback is spread over the next updates
+// while the session keeps advancing from the last state on display. values below 2 couldnt catch up and turn it off.
+// only applies to game sessions saving every frame without runahead.
+GEKKONET_API void gekko_set_rollback_budget(GekkoSession* session, unsigned char frames);
+
+// changes the input prediction window of a started game session and resizes the state storage to match.
+// a wider window applies right away, a narrower one once the session isnt predicting past it anymore.
+// lockstep sessions (a window of 0) cant switch to rollback and the other way around.
+// in zero allocation mode resizing the storage counts as slips.
+GEKKONET_API void gekko_set_prediction_window(GekkoSession* session, unsigned char window);
+
+// lets the session size the prediction window from the round trip time and jitter it measures, stalls on
+// an exhausted window widen it right away. passing NULL turns it off and keeps the current window.
+GEKKONET_API void gekko_set_adaptive_prediction_window(GekkoSession* session, GekkoAdaptivePredictionWindow* settings);
+
 GEKKONET_API void gekko_add_local_input(GekkoSession* session, int player, void* input);
 
+// zero copy alternative to gekko_add_local_input. hands out the storage the input of a local player
+// for the current frame lives in, write input_size bytes into it and submit all of them with gekko_commit_local_inputs.
+// acquiring and committing has to happen between the same two session updates.
+// returns false when the player isnt a local player or the frame already has its input, eg. while the session
+// waits on remote inputs and doesnt advance. the input for that frame would be dropped so there is nothing to write.
+GEKKONET_API bool gekko_acquire_local_input(GekkoSession* session, int player, void** input);
+
+GEKKONET_API void gekko_commit_local_inputs(GekkoSession* session);
+
 GEKKONET_API GekkoGameEvent** gekko_update_session(GekkoSession* session, int* count);
 
+// registers callbacks the session calls while updating, gekko_update_session then returns no events.
+// passing NULL switches back to the event array.
+GEKKONET_API void gekko_set_sim_callbacks(GekkoSession* session, GekkoSimCallbacks* callbacks);
+
+// starts one worker thread per branch for speculative prediction, passing NULL or 0 branches stops them.
+// call after gekko_start, it needs the sim callbacks, a prediction window and limited_saving turned off.
+GEKKONET_API void gekko_set_speculation(GekkoSession* session, GekkoSpeculationCallbacks* callbacks, unsigned char num_branches);
+
 GEKKONET_API GekkoSessionEvent** gekko_session_events(GekkoSession* session, int* count);
 
 GEKKONET_API float gekko_frames_ahead(GekkoSession* session);
 
+// the peers estimate their clock offsets while connecting and agree on when to simulate frame 0 together,
+// updates dont advance before then. returns the time left until that start in microseconds, 0 once it
+// passed and -1 while the peers are still connecting.
+GEKKONET_API int gekko_session_start_time(GekkoSession* session);
+
+// recommends when to run the next update, derived from the arrival times of the remote inputs,
+// the frame advantage and the round trip time through a phase locked loop.
+GEKKONET_API void gekko_timing_advice(GekkoSession* session, GekkoTimingAdvice* advice);
+
 GEKKONET_API void gekko_network_stats(GekkoSession* session, int player, GekkoNetworkStats* stats);
 
 GEKKONET_API void gekko_network_poll(GekkoSession* session);
 
+// fills in the memory currently held by the session, broken down by subsystem.
+GEKKONET_API void gekko_memory_report(GekkoSession* session, GekkoMemoryReport* report);
+
+// debug hook to catch allocations that slip through in zero allocation mode, passing NULL removes it.
+GEKKONET_API void gekko_set_allocation_hook(GekkoSession* session, GekkoAllocationHook hook, void* user_data);
+
 #ifndef GEKKONET_NO_ASIO
 
 GEKKONET_API GekkoNetAdapter* gekko_default_adapter(unsigned short port);
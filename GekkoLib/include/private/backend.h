@@ -7,7 +7,9 @@
 #include "compression.h"
 #include "net.h"
 #include "event.h"
+#include "memory.h"
 
+#include <array>
 #include <memory>
 #include <list>
 #include <vector>
@@ -23,12 +25,23 @@ namespace Gekko {
         Disconnected,
     };
 
-	struct InputCache {
-		Frame last_acked_frame = -1;
-		Frame last_input_frame = -1;
-		std::vector<InputMsg> packets;
+	struct InputRange {
+		Frame start_frame;
+		u32 count;
+	};
 
-		bool IsValid(Frame current_ack, Frame current_last_input) const;
+	// what was sent to a peer so far, new frames go out once and unacked ones only get resent
+	// when the peer reports them missing or theyve been out for a retry interval.
+	struct InputSendState {
+		// larger than the input queue so every frame it holds gets its own slot.
+		static const u32 HISTORY_SIZE = 256;
+
+		// newest frame sent to the peer.
+		Frame last_sent_frame = -1;
+		// when each frame last went out, indexed by frame.
+		std::array<u64, HISTORY_SIZE> send_times = {};
+		// scratch for the ranges picked each send, the encoded packets for them are shared between peers.
+		Vector<InputRange, MemNetwork> ranges;
 	};
 
 	struct AdvantageHistory {
@@ -43,9 +56,22 @@ namespace Gekko {
 
 		void SetRemoteAdvantage(i8 adv);
 
+		// sub frame advantages measured whenever inputs arrive, smoothed for the frame pacing.
+		void AddLocalArrival(f32 adv);
+
+		void AddRemoteArrival(f32 adv);
+
+		f32 GetArrivalAdvantage();
+
 	private:
 		static const i32 HISTORY_SIZE = 26;
 
+		static constexpr f32 ARRIVAL_SMOOTHING = 1.f / 16.f;
+
+		f32 _local_arrival = 0.f;
+
+		f32 _remote_arrival = 0.f;
+
         i8 _local_frame_adv;
 
         i8 _remote_frame_adv;
@@ -79,21 +105,19 @@ namespace Gekko {
 
 		NetAddress address;
 
-        std::map<Frame, u32> session_health;
-
-		InputCache input_cache;
+        Map<Frame, u32> session_health;
 
-		u64 last_input_send_time = 0;
+		InputSendState input_send;
 
 		u8 disconnect_msgs_left = 0;
 
 		u64 last_disconnect_msg_time = 0;
 
 		// the disconnect frames this peer last claimed per disconnected player.
-		std::map<Handle, Frame> peer_claims;
+		Map<Handle, Frame> peer_claims;
 
 		// the disconnect frames we last claimed towards this peer.
-		std::map<Handle, Frame> peer_claims_sent;
+		Map<Handle, Frame> peer_claims_sent;
 
 		// the session wide agreed frame after which this players inputs are voided.
 		Frame disconnect_frame = INT32_MAX;
@@ -108,19 +132,87 @@ namespace Gekko {
 
 		AdvantageHistory adv_history;
 
+		// the peers last sync timestamp and the local time it arrived at, echoed back in the next sync message.
+		u64 sync_remote_time = 0;
+
+		u64 sync_receive_time = 0;
+
+		// the peers clock minus the local one, taken from the sync sample with the quickest round trip.
+		i64 clock_offset = 0;
+
+		u64 clock_rtt = UINT64_MAX;
+
+		// the start the peer proposed on the local clock, 0 until it did.
+		u64 start_time = 0;
+
+		u8 start_msgs_left = 0;
+
+		// the protocol the peer announced while syncing, 0 until it did.
+		u8 protocol_version = 0;
+
+		// the newest contiguous frame received from this player and the advantage measured with it,
+		// pending until it went out on an input packet or in an ack of its own.
+		Frame ack_frame = -1;
+
+		i8 ack_advantage = 0;
+
+		u8 ack_phase = 0;
+
+		bool ack_pending = false;
+
+		// the interned address of the actor, see PeerTable.
+		u32 peer;
+
 	private:
         GekkoPlayerType _type;
 
 		PlayerStatus _status;
 	};
 
+	// interns the addresses of the remote actors and spectators, every distinct address is a peer
+	// with a compact id. received packets are hashed once and looked up in an open addressed table,
+	// the id then indexes flat per peer arrays instead of comparing the address against every actor.
+	class PeerTable {
+	public:
+		static constexpr u32 INVALID_PEER = UINT32_MAX;
+
+		// returns the id of the address, adding a peer when its new. the address has to outlive the table.
+		u32 Intern(NetAddress* addr);
+
+		u32 Find(NetAddress& addr);
+
+		void AddActor(u32 peer, Player* actor);
+
+		// the actors at the peer in the order they were added, empty for an unknown peer.
+		Vector<Player*, MemNetwork>& GetActors(u32 peer);
+
+	private:
+		static u64 Hash(NetAddress& addr);
+
+		void Insert(u32 peer);
+
+		void Rehash(u32 capacity);
+
+	private:
+		// linear probing over a power of two, half empty at most so a probe always ends.
+		Vector<u32, MemNetwork> _slots;
+
+		Vector<u64, MemNetwork> _hashes;
+
+		Vector<NetAddress*, MemNetwork> _addresses;
+
+		Vector<Vector<Player*, MemNetwork>, MemNetwork> _actors;
+
+		Vector<Player*, MemNetwork> _no_actors;
+	};
+
 	class MessageSystem {
 	public:
 		MessageSystem();
 
         void Init(u8 num_players, u32 input_size);
 
-		void AddInput(Frame input_frame, Handle player, u8 input[], bool remote = false);
+		void AddInput(Frame input_frame, Handle player, u8 input[]);
 
 		void AddSpectatorInput(Frame input_frame, u8 input[]);
 
@@ -128,12 +220,19 @@ namespace Gekko {
 
 		void HandleData(GekkoNetAdapter* host, GekkoNetResult** data, u32 length);
 
-		void SendInputAck(Handle player, Frame frame, i8 local_advantage);
+		// acks are cumulative, only the newest frame per player is kept and reported once per flush.
+		void QueueInputAck(Handle player, Frame frame, i8 local_advantage, u8 frame_phase);
 
 		Frame GetLastAddedInput(bool spectator = false);
 
+		// adds the actor to the locals, remotes or spectators and registers its address.
+		Player* AddActor(Handle handle, GekkoPlayerType type, NetAddress* addr);
+
 		bool CheckStatusActors();
 
+		// the start the connected peers agreed on in microseconds on the local steady clock, 0 until proposed.
+		u64 GetStartTime();
+
 		bool DisconnectActor(Handle handle);
 
 		void SetDisconnectTimeout(u32 timeout);
@@ -146,22 +245,24 @@ namespace Gekko {
 
         Frame GetLastAddedInputFrom(Handle player);
 
-        std::deque<std::unique_ptr<u8[]>>& GetNetPlayerQueue(Handle player);
+        Deque<u8*, MemInput>& GetNetPlayerQueue(Handle player);
 
 	public:
-		std::vector<std::unique_ptr<Player>> locals;
+		Vector<UniquePtr<Player>> locals;
 
-		std::vector<std::unique_ptr<Player>> remotes;
+		Vector<UniquePtr<Player>> remotes;
 
-		std::vector<std::unique_ptr<Player>> spectators;
+		Vector<UniquePtr<Player>> spectators;
 
 		SessionEventSystem session_events;
 
-        std::map<Frame, u32> local_health;
+        Map<Frame, u32> local_health;
 
+        // local inputs are referenced in place within the sync systems input buffers,
+        // everything received over the network is copied into the queues own ring storage.
         struct NetInputQueue {
             Frame last_added_input = -1;
-            std::deque<std::unique_ptr<u8[]>> inputs;
+            Deque<u8*, MemInput> inputs;
 
             NetInputQueue(const NetInputQueue&) = delete;
             NetInputQueue& operator=(const NetInputQueue&) = delete;
@@ -171,21 +272,95 @@ namespace Gekko {
 
             NetInputQueue() = default;
 
+            void Init(u32 entry_size, u32 capacity);
+
+            u8* GetSlot(Frame frame);
+
             void TrimToAck(Frame min_ack, u32 max_size);
+
+            // the frames past the given one that arrived already, in the layout of InputAckMsg::received.
+            u32 ReceivedAfter(Frame frame) const;
+
+            // remote inputs that arrived ahead of a gap wait in their slots, bit i stands for last_added_input + 1 + i.
+            u32 received_ahead = 0;
+
+        private:
+            u32 _entry_size = 0;
+
+            u32 _capacity = 0;
+
+            UniquePtr<u8[]> _storage;
+        };
+
+        // a datagram on its way out, messages are serialized into it as soon as theyre queued
+        // and flushing only hands the bytes to the adapter.
+        struct OutputBuffer {
+            u32 peer = PeerTable::INVALID_PEER;
+            Vector<u8, MemNetwork> data;
         };
 
+		static const u32 MAX_INPUT_QUEUE_SIZE = 128;
+
+		// how far past a gap remote inputs are kept and selectively acked.
+		static const u32 SACK_WINDOW = 32;
+
+		// spectator input packets start on multiples of this so spectators acked close to each other share them.
+		static const u32 INPUT_PACKET_ALIGNMENT = 8;
+
+		// how many of the latest unacked frames ride along with every new one.
+		static const u32 INPUT_REDUNDANCY = 2;
+
+		static const u32 ENCODED_INPUT_CACHE_SIZE = 16;
+
 	private:
-		void SendSyncRequest(NetAddress* addr);
+		void SendSyncRequest(u32 peer);
 
-		void SendSyncResponse(NetAddress* addr, u16 magic);
+		void SendSyncResponse(u32 peer, u16 magic);
 
-		void SendDisconnect(NetAddress* addr, u16 magic);
+		// fills in the timestamps for the peer.
+		void WriteSyncTimes(SyncMsg& body, u32 peer);
+
+		void ReadSyncTimes(Player* player, SyncMsg* body, u64 now_us);
+
+		void ProposeStart(u64 now_us);
+
+		void SendDisconnect(u32 peer, u16 magic);
 
 		void SendPendingDisconnects();
 
-		void SendInputsToPeer(Player* peer, GekkoNetAdapter* host, bool spectator);
+		void SendInputsToPeer(Player* peer, bool spectator);
+
+		// returns the packet for the frame range, encoded only once no matter how many peers send it.
+		InputMsg& GetEncodedInputs(bool spectator, Frame start_frame, u32 count);
+
+		// sends the acks that didnt ride along on an input packet.
+		void SendPendingAcks();
+
+		// fills in the ack towards the peer and marks it as sent, false when there was nothing new.
+		bool CollectInputAck(u32 peer, InputAckMsg& ack);
+
+		void ApplyInputAck(u32 peer, const InputAckMsg& ack);
+
+		void GetRemoteHandlesForPeer(u32 peer, Vector<Handle>& result);
+
+		// serializes the message into the datagram going out to the peer on the next flush.
+		template <typename Msg>
+		void QueueMessage(u32 peer, PacketType type, u16 magic, const Msg& body);
+
+		// queues the message for every connected remote and spectator, serializing the body once.
+		template <typename Msg>
+		void QueueMessageToAll(PacketType type, const Msg& body);
 
-		std::vector<Handle> GetRemoteHandlesForAddress(NetAddress* addr);
+		// returns the datagram the next message to the peer is written into, bundling it with
+		// the ones before when the peer understands bundles.
+		u32 OpenOutput(u32 peer);
+
+		// moves the message written from start on into a datagram of its own when it overflowed this one.
+		void CloseOutput(u32 index, u32 start);
+
+		u32 AcquireOutput(u32 peer);
+
+		void FlushOutput(GekkoNetAdapter* host);
 
 		Player* GetPlayerByHandle(Handle handle);
 
@@ -201,32 +376,50 @@ namespace Gekko {
 
 		u64 TimeSinceEpoch();
 
-        void SendDataToAll(NetData* pkt, GekkoNetAdapter* host, bool spectators_only = false);
+		u64 MicrosSinceEpoch();
 
-        void SendDataTo(NetData* pkt, GekkoNetAdapter* host);
+        bool CanBundle(u32 peer);
 
-        void ParsePacket(NetAddress& addr, NetPacket& pkt, u32 packet_size);
+        void ParsePacket(NetAddress& addr, NetPacketView& pkt, u32 packet_size);
 
-        void OnSyncRequest(NetAddress& addr, NetPacket& pkt);
+        void OnSyncRequest(u32 peer, NetPacketView& pkt);
 
-        void OnSyncResponse(NetAddress& addr, NetPacket& pkt);
+        void OnSyncResponse(u32 peer, NetPacketView& pkt);
 
-        void OnInputs(NetAddress& addr, NetPacket& pkt);
+        void OnInputs(u32 peer, NetPacketView& pkt);
 
-        void OnInputAck(NetAddress& addr, NetPacket& pkt);
+        // decodes a received input straight into its queue slot, false when the payload ran out.
+        // inputs arriving past a gap are held until the gap is filled.
+        bool ReadRemoteInput(Frame input_frame, Handle player, Compression::Reader& reader);
 
-        void OnSessionHealth(NetAddress& addr, NetPacket& pkt);
+        void OnInputAck(u32 peer, NetPacketView& pkt);
 
-        void OnNetworkHealth(NetAddress& addr, NetPacket& pkt);
+        void OnSessionHealth(u32 peer, NetPacketView& pkt);
 
-        void OnDisconnect(NetAddress& addr, NetPacket& pkt);
+        void OnNetworkHealth(u32 peer, NetPacketView& pkt);
 
-        void OnDisconnectClaim(NetAddress& addr, NetPacket& pkt);
+        void OnDisconnect(u32 peer, NetPacketView& pkt);
+
+        void OnDisconnectClaim(u32 peer, NetPacketView& pkt);
 
 	private:
-		const u32 MAX_INPUT_QUEUE_SIZE = 128;
 	    const u32 NUM_TO_SYNC = 4;
 	    const u8 NUM_DISCONNECT_MSGS = 5;
+	    const u8 NUM_START_MSGS = 5;
+
+	    // the protocol spoken by this build and the first one that reads multiple messages per datagram.
+	    const u8 PROTOCOL_VERSION = 1;
+	    const u8 BUNDLING_VERSION = 1;
+
+	    // bundles are kept below the common path mtu so they dont get fragmented.
+	    const u32 MAX_DATAGRAM_SIZE = 1200;
+
+	    // time from proposing the start until the session begins on top of twice the slowest round trip,
+	    // the proposal is sent again each update meanwhile.
+	    const u64 START_DELAY_US = 50000;
+
+	    // a proposal further out than this past the own one is taken for a bad clock estimate.
+	    const u64 MAX_START_SKEW_US = 1000000;
 
 		u32 _input_size;
 
@@ -237,15 +430,51 @@ namespace Gekko {
         u8  _num_players;
 
         // input queue for each player for either sending or receiving
-        std::vector<NetInputQueue> _net_player_queue;
+        Vector<NetInputQueue, MemInput> _net_player_queue;
 
         // input queue for spectator inputs
         NetInputQueue _net_spectator_queue;
 
-		std::queue<std::unique_ptr<NetData>> _pending_output;
+        // the pooled datagrams, the first _output_count of them are waiting for the next flush.
+        Vector<OutputBuffer, MemNetwork> _output;
+
+        u32 _output_count;
 
-        std::vector<u8> _bin_buffer;
+        // the datagram each peer currently bundles its messages into, indexed by peer.
+        Vector<u32, MemNetwork> _open_output;
+
+        // input packets encoded already, keyed by their frame range and evicted least recently used first.
+        struct EncodedInputs {
+            bool spectator = false;
+            Frame start_frame = -1;
+            u32 count = 0;
+            u64 last_used = 0;
+            InputMsg msg;
+        };
+
+        Vector<EncodedInputs, MemNetwork> _encoded_inputs;
+
+        u64 _encode_clock;
+
+        // scratch space kept around so sending and receiving doesnt allocate while running.
+        Vector<u8, MemNetwork> _body_buffer;
+
+        Vector<u8, MemCompression> _rle_buffer;
+
+        Vector<Handle> _addr_handles;
+
+        PeerTable _peers;
+
+        // the players indexed by their handle.
+        Vector<Player*, MemNetwork> _players;
+
+        NetAddress _recv_addr;
+
+        NetPacketView _recv_pkt;
 
         u64 _last_sent_network_check;
+
+        // the start this session proposed on the local clock.
+        u64 _start_time;
 	};
 }
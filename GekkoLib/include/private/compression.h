@@ -1,9 +1,13 @@
 #pragma once
 
 #include "gekko_types.h"
+#include "memory.h"
 
 #include <iostream>
 #include <vector>
+#include <span>
+#include <cstring>
+#include <algorithm>
 
 namespace Gekko {
     struct Compression {
@@ -16,8 +20,9 @@ namespace Gekko {
             std::cout << "_______________\n";
         }
 
-        static std::vector<uint8_t> RLEEncode(const uint8_t* data, u32 length) {
-            std::vector<uint8_t> result;
+        // the results are written into the given buffers so they can be reused.
+        static void RLEEncode(const uint8_t* data, u32 length, Vector<u8, MemCompression>& result) {
+            result.clear();
 
             u32 idx = 0;
             u8 count = 0;
@@ -32,11 +37,10 @@ namespace Gekko {
                 result.push_back(data[idx]);
                 idx++;
             }
-            return result;
         }
 
-        static std::vector<uint8_t> RLEDecode(const uint8_t* data, u32 length) {
-            std::vector<uint8_t> result;
+        static void RLEDecode(const uint8_t* data, u32 length, Vector<u8, MemCompression>& result) {
+            result.clear();
 
             u32 idx = 0;
             u8 count = 0;
@@ -52,10 +56,61 @@ namespace Gekko {
 
                 idx += 2;
             }
-
-            return result;
         }
 
+        // reads a payload piece by piece, run length decoding it on the fly when it is encoded,
+        // so it lands straight in its destination without going through a buffer first.
+        struct Reader {
+            Reader(std::span<const u8> data, bool encoded)
+                : _data(data), _idx(0), _encoded(encoded), _run(0), _value(0) {}
+
+            // returns false when the payload ran out before the requested length.
+            bool Read(u8* out, u32 length) {
+                if (!_encoded) {
+                    if (length > _data.size() - _idx) {
+                        return false;
+                    }
+                    if (out) {
+                        std::memcpy(out, _data.data() + _idx, length);
+                    }
+                    _idx += length;
+                    return true;
+                }
+
+                while (length > 0) {
+                    if (_run == 0) {
+                        if (_idx + 1 >= _data.size()) {
+                            return false;
+                        }
+                        _run = _data[_idx];
+                        _value = _data[_idx + 1];
+                        _idx += 2;
+                        continue;
+                    }
+
+                    const u32 count = std::min((u32)_run, length);
+                    if (out) {
+                        std::memset(out, _value, count);
+                        out += count;
+                    }
+                    _run -= (u8)count;
+                    length -= count;
+                }
+                return true;
+            }
+
+            bool Skip(u32 length) {
+                return Read(nullptr, length);
+            }
+
+        private:
+            std::span<const u8> _data;
+            u32 _idx;
+            bool _encoded;
+            u8 _run;
+            u8 _value;
+        };
+
         Compression() = delete;
     };
 }
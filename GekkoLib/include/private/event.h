@@ -11,41 +11,79 @@
 namespace Gekko {
     struct GameEventBuffer {
     public:
-        void Init(u32 input_size);
+        void Init(u32 input_size, u32 max_advance, u32 max_others);
+
+        void Reserve(u32 max_advance, u32 max_others);
 
         GekkoGameEvent* GetEvent(bool advance);
 
         void Reset();
 
+    private:
+        void Allocate();
+
     private:
         u32 _input_size = 0;
 
-        u16 _index_others = 0;
+        u32 _max_advance = 0;
+
+        u32 _max_others = 0;
+
+        u32 _reserve_advance = 0;
+
+        u32 _reserve_others = 0;
+
+        u32 _index_others = 0;
+
+        u32 _index_advance = 0;
 
-        u16 _index_advance = 0;
+        // advance events followed by the other events in one contiguous block.
+        UniquePtr<GekkoGameEvent[]> _events;
 
-        std::vector<std::unique_ptr<GekkoGameEvent>> _buffer_advance;
+        // input memory backing every preallocated advance event.
+        UniquePtr<u8[]> _input_memory;
 
-        std::vector<std::unique_ptr<GekkoGameEvent>> _buffer_others;
+        // fallback for an update producing more events than preallocated,
+        // the pool grows to fit on the next reset.
+        Vector<UniquePtr<GekkoGameEvent>, MemEvents> _overflow_advance;
 
-        std::vector<std::unique_ptr<u8[]>> _input_memory_buffer;
+        Vector<UniquePtr<GekkoGameEvent>, MemEvents> _overflow_others;
+
+        Vector<UniquePtr<u8[]>, MemEvents> _overflow_input_memory;
     };
 
     struct GameEventSystem {
     public:
-        void Init(u32 input_size);
+        void Init(u32 input_size, u32 max_advance, u32 max_others);
+
+        void Reserve(u32 max_advance, u32 max_others);
 
-        bool AddAdvanceEvent(SyncSystem& sync, bool rolling_back, bool running_ahead = false);
+        bool AddAdvanceEvent(SyncSystem& sync, bool rolling_back, bool running_ahead = false, bool fast_forward = false);
 
         void AddSaveEvent(SyncSystem& sync, StateStorage& storage, Frame* last_saved_frame = nullptr);
 
         void AddLoadEvent(SyncSystem& sync, StateStorage& storage);
 
-        void AddRunaheadSaveEvent(SyncSystem& sync, StateStorage& storage);
+        void AddLoadEvent(StateStorage& storage, Frame frame);
+
+        // saves the state ran ahead to frame along with the inputs it was simulated with.
+        void AddRunaheadSaveEvent(SyncSystem& sync, StateStorage& storage, Frame frame);
+
+        void AddRunaheadLoadEvent(StateStorage& storage, Frame frame);
+
+        void SetCallbacks(GekkoSimCallbacks* callbacks);
+
+        bool UsesCallbacks() const;
+
+        // tags the events added from now on.
+        void SetInstance(GekkoSimInstance instance);
+
+        // the advances since the last reset and the time spent in the callbacks.
+        u32 GetAdvanceCount() const;
 
-        void AddRunaheadLoadEvent(StateStorage& storage);
+        u32 GetSimTime() const;
 
-        std::vector<GekkoGameEvent*>& GetEvents();
+        Vector<GekkoGameEvent*, MemEvents>& GetEvents();
 
         void Reset();
 
@@ -56,30 +94,60 @@ namespace Gekko {
         GekkoGameEvent** Data();
 
     private:
-        std::vector<GekkoGameEvent*> _current_events;
+        GekkoGameEvent* NextEvent(bool advance);
+
+        void Dispatch(GekkoGameEvent* ev);
+
+    private:
+        Vector<GekkoGameEvent*, MemEvents> _current_events;
 
         GameEventBuffer _event_buffer;
+
+        u32 _input_size = 0;
+
+        bool _use_callbacks = false;
+
+        GekkoSimCallbacks _callbacks = {};
+
+        // the single event handed to the callbacks, its reused for every call.
+        GekkoGameEvent _callback_event = {};
+
+        GekkoSimInstance _instance = GekkoPrimaryInstance;
+
+        u32 _num_advances = 0;
+
+        u64 _sim_time_us = 0;
     };
 
     struct SessionEventBuffer {
     public:
-        SessionEventBuffer();
+        void Init(u32 max_events);
 
         GekkoSessionEvent* GetEvent();
 
         void Reset();
 
     private:
-        u16 _index;
+        u32 _index = 0;
+
+        u32 _max_events = 0;
 
-        std::vector<std::unique_ptr<GekkoSessionEvent>> _buffer;
+        UniquePtr<GekkoSessionEvent[]> _events;
+
+        // fallback for bursts beyond the preallocated events, the pool grows to fit on the next reset.
+        Vector<UniquePtr<GekkoSessionEvent>, MemEvents> _overflow;
     };
 
     struct SessionEventSystem {
     public:
+        // events preallocated per actor, enough to cover syncing and disconnect bursts.
+        static const u32 EVENTS_PER_ACTOR = 8;
+
+        void Init(u32 max_events);
+
         void Reset();
 
-        std::vector<GekkoSessionEvent*>& GetRecentEvents();
+        Vector<GekkoSessionEvent*, MemEvents>& GetRecentEvents();
 
         void AddPlayerSyncingEvent(Handle handle, u8 sync, u8 max);
 
@@ -99,7 +167,7 @@ namespace Gekko {
         void AddEvent(GekkoSessionEvent* ev);
 
     private:
-        std::vector<GekkoSessionEvent*> _events;
+        Vector<GekkoSessionEvent*, MemEvents> _events;
 
         SessionEventBuffer _event_buffer;
     };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "gekko_types.h"
+#include "memory.h"
 #include <deque>
 #include <memory>
 
@@ -22,7 +23,7 @@ namespace Gekko {
 
 		Frame frame;
 
-		std::unique_ptr<u8[]> input;
+		UniquePtr<u8[]> input;
 
 		u32 input_len;
 	};
@@ -36,19 +37,32 @@ namespace Gekko {
 
 		void AddLocalInput(Frame frame, u8* input);
 
+		u8* AcquireLocalInput(Frame frame);
+
+		void CommitLocalInput();
+
 		void AddInput(Frame frame, u8* input);
 
 		void OverwriteInput(Frame frame, u8* input);
 
 		void SetDelay(u8 delay);
 
+		// fills up to the given frame with the last input received.
+		void RepeatLastInput(Frame up_to);
+
+		// fills up to the given frame with empty inputs, the same the delay starts out with.
+		void PadEmptyInput(Frame up_to);
+
 		u8 GetDelay();
 		
 		void SetInputPredictionWindow(u8 input_window);
 
 		Frame GetIncorrectPredictionFrame();
 
-		std::unique_ptr<GameInput> GetInput(Frame frame, bool prediction = false);
+		// a view of the stored or predicted input, only valid until the buffer changes.
+		GameInput* GetInput(Frame frame, bool prediction = false);
+
+		u8* GetInputData(Frame frame);
 
 		void SetRunaheadMode(bool running_ahead);
 
@@ -56,7 +70,12 @@ namespace Gekko {
 
         void ClearIncorrectFrames(Frame clear_limit);
 
+		// the verified predictions since the last call.
+		void TakePredictionCounts(u32& hits, u32& misses);
+
 	private:
+		void AddDelayInputs(Frame frame);
+
 		void ResetPrediction();
 
 		u32 PreviousFrame(Frame frame);
@@ -76,7 +95,9 @@ namespace Gekko {
 
 		u32 _buff_size;
 
-        std::unique_ptr<u8[]> _empty_input;
+        UniquePtr<u8[]> _empty_input;
+
+		Frame _acquired_input;
 
 		Frame _last_received_input;
 
@@ -84,8 +105,15 @@ namespace Gekko {
 
 		Frame _first_predicted_input;
 
-		std::deque<Frame> _incorrent_predicted_inputs;
+		u32 _prediction_hits;
+
+		u32 _prediction_misses;
+
+		Deque<Frame, MemInput> _incorrent_predicted_inputs;
+
+		Deque<UniquePtr<GameInput>, MemInput> _inputs;
 
-		std::deque<std::unique_ptr<GameInput>> _inputs;
+		// handed out when theres no input for the requested frame.
+		GameInput _missing_input;
 	};
 }
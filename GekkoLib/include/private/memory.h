@@ -0,0 +1,189 @@
+#pragma once
+
+#include "gekkonet.h"
+#include "gekko_types.h"
+
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <new>
+#include <queue>
+#include <type_traits>
+#include <vector>
+
+namespace Gekko {
+
+    // subsystems the session memory is accounted to, mirrors GekkoMemoryTag.
+    enum MemTag : u8 {
+        MemSession = GekkoMemorySession,
+        MemInput = GekkoMemoryInput,
+        MemStorage = GekkoMemoryStorage,
+        MemEvents = GekkoMemoryEvents,
+        MemNetwork = GekkoMemoryNetwork,
+        MemCompression = GekkoMemoryCompression,
+        MemTagCount = GekkoMemoryTagCount
+    };
+
+    struct MemSlab;
+
+    // every session owns one context, all of its allocations go through the allocator
+    // it was created with and are accounted to the subsystem that requested them.
+    struct MemContext {
+        static const u32 NUM_CLASSES = 7;
+
+        GekkoAllocator allocator;
+
+        size_t bytes[MemTagCount] = {};
+        size_t total_bytes = 0;
+        size_t peak_bytes = 0;
+        size_t num_allocs = 0;
+
+        // zero allocation mode, small blocks are carved from prefaulted slabs and recycled
+        // through per size class free lists instead of going back to the allocator.
+        bool pooled = false;
+        bool lock = false;
+
+        // set once the session started, from then on nothing should reach the allocator.
+        bool steady = false;
+        size_t steady_allocs = 0;
+
+        GekkoAllocationHook hook = nullptr;
+        void* hook_user_data = nullptr;
+
+        void* free_lists[NUM_CLASSES] = {};
+
+        MemSlab* slabs = nullptr;
+        MemSlab* spare_slabs = nullptr;
+        u8* slab_cursor = nullptr;
+        u8* slab_end = nullptr;
+
+        size_t reserved_bytes = 0;
+    };
+
+    namespace Memory {
+        // creates a context backed by the given allocator, or by the global heap when null.
+        MemContext* CreateContext(GekkoAllocator* allocator);
+
+        void DestroyContext(MemContext* ctx);
+
+        // allocates from the context of the session that is currently being called into.
+        void* Alloc(size_t size, MemTag tag);
+
+        // returns the memory to the context it was allocated from.
+        void Free(void* ptr);
+
+        // number of bytes an allocation made through Alloc holds.
+        size_t SizeOf(void* ptr);
+
+        MemContext* Current();
+
+        // switches the context to zero allocation mode, only affects allocations made after.
+        void EnablePooling(MemContext* ctx, bool lock);
+
+        // makes sure at least the given amount of slab memory is ready to be handed out.
+        void Reserve(MemContext* ctx, size_t bytes);
+
+        // touches every page of an allocation that was made before pooling got enabled.
+        void Prefault(void* ptr);
+
+        // marks the end of the setup phase of the session using the current context.
+        void MarkSteady();
+
+        void Report(MemContext* ctx, GekkoMemoryReport* report);
+
+        // routes the allocations on this thread to a context for the lifetime of the scope.
+        struct Scope {
+            explicit Scope(MemContext* ctx);
+            ~Scope();
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            MemContext* _prev;
+        };
+    }
+
+    // stateless standard allocator, the owning context is stored along with every block.
+    template<typename T, MemTag TAG>
+    struct Allocator {
+        using value_type = T;
+
+        template<typename U>
+        struct rebind {
+            using other = Allocator<U, TAG>;
+        };
+
+        Allocator() = default;
+
+        template<typename U>
+        Allocator(const Allocator<U, TAG>&) {}
+
+        T* allocate(size_t n) {
+            return static_cast<T*>(Memory::Alloc(n * sizeof(T), TAG));
+        }
+
+        void deallocate(T* ptr, size_t) {
+            Memory::Free(ptr);
+        }
+
+        template<typename U>
+        bool operator==(const Allocator<U, TAG>&) const { return true; }
+
+        template<typename U>
+        bool operator!=(const Allocator<U, TAG>&) const { return false; }
+    };
+
+    template<typename T>
+    struct Deleter {
+        void operator()(T* ptr) const {
+            ptr->~T();
+            Memory::Free(ptr);
+        }
+    };
+
+    template<typename T>
+    struct Deleter<T[]> {
+        void operator()(T* ptr) const {
+            if constexpr (!std::is_trivially_destructible_v<T>) {
+                const size_t count = Memory::SizeOf(ptr) / sizeof(T);
+                for (size_t i = 0; i < count; i++) {
+                    ptr[i].~T();
+                }
+            }
+            Memory::Free(ptr);
+        }
+    };
+
+    template<typename T>
+    using UniquePtr = std::unique_ptr<T, Deleter<T>>;
+
+    template<typename T, MemTag TAG = MemSession>
+    using Vector = std::vector<T, Allocator<T, TAG>>;
+
+    template<typename T, MemTag TAG = MemSession>
+    using Deque = std::deque<T, Allocator<T, TAG>>;
+
+    template<typename T, MemTag TAG = MemSession>
+    using Queue = std::queue<T, Deque<T, TAG>>;
+
+    template<typename K, typename V, MemTag TAG = MemSession>
+    using Map = std::map<K, V, std::less<K>, Allocator<std::pair<const K, V>, TAG>>;
+
+    template<typename T, MemTag TAG = MemSession, typename... Args>
+    UniquePtr<T> MakeUnique(Args&&... args) {
+        void* mem = Memory::Alloc(sizeof(T), TAG);
+        return UniquePtr<T>(new (mem) T(std::forward<Args>(args)...));
+    }
+
+    // value initialized like std::make_unique<T[]>.
+    template<typename T, MemTag TAG = MemSession>
+    UniquePtr<T[]> MakeUniqueArray(size_t count) {
+        T* ptr = static_cast<T*>(Memory::Alloc(count * sizeof(T), TAG));
+        for (size_t i = 0; i < count; i++) {
+            new (ptr + i) T();
+        }
+        return UniquePtr<T[]>(ptr);
+    }
+}
@@ -2,10 +2,12 @@
 
 #include "gekkonet.h"
 #include "gekko_types.h"
+#include "memory.h"
 
 #include <memory>
 #include <vector>
 #include <variant>
+#include <span>
 #include <chrono>
 
 namespace Gekko {
@@ -19,9 +21,14 @@ namespace Gekko {
         void Copy(NetAddress* other);
         bool Equals(NetAddress& other);
 
+        // reuses the current storage when the new address fits.
+        void Set(void* data, u32 size);
+        void Clear();
+
     private:
-        std::unique_ptr<u8[]> _data;
+        UniquePtr<u8[]> _data;
         u32 _size;
+        u32 _capacity;
     };
 
     enum PacketType : u8 {
@@ -41,22 +48,40 @@ namespace Gekko {
         u16 magic;
     };
 
+    struct InputAckMsg {
+        Frame ack_frame;
+        i8 frame_advantage;
+        // progress into the senders current frame when it measured the advantage, in 1/256 frames.
+        u8 frame_phase;
+        // the frames past ack_frame that arrived already, bit i stands for ack_frame + 1 + i.
+        u32 received;
+    };
+
     struct InputMsg {
         Frame start_frame;
         u16 input_count;
         u16 total_size;
         bool compressed;
+        // the inputs received from the recipient so far ride along, ack_frame is -1 when there are none.
+        InputAckMsg ack;
 
-        std::vector<u8> inputs;
-    };
-
-    struct InputAckMsg {
-        Frame ack_frame;
-        i8 frame_advantage;
+        Vector<u8, MemNetwork> inputs;
     };
 
+    // the timestamps estimate the clock offset ntp style, all in microseconds on the senders steady clock
+    // except for receive_time which the peer took on its own.
     struct SyncMsg {
         u16 rng_data;
+        // the protocol the sender speaks, see MessageSystem::PROTOCOL_VERSION.
+        u8 protocol_version;
+        // the last transmit_time received from the peer, when it arrived and when this one was sent.
+        u64 origin_time;
+        u64 receive_time;
+        u64 transmit_time;
+        // the proposed start of the session, 0 while the sender is still connecting.
+        u64 start_time;
+        // the sender proposed already but is still missing the recipients proposal.
+        bool awaiting_start;
     };
 
     struct SessionHealthMsg {
@@ -79,7 +104,7 @@ namespace Gekko {
         Frame start_frame;
         Frame last_frame;
 
-        std::vector<u8> inputs;
+        Vector<u8, MemNetwork> inputs;
     };
 
     using MsgBody = std::variant<
@@ -92,14 +117,59 @@ namespace Gekko {
         DisconnectClaimMsg
     >;
 
+    // the id the message is tagged with inside MsgBody on the wire, so it can be serialized without the variant.
+    template <typename Msg, typename... Msgs>
+    constexpr u8 MsgIndex(std::variant<Msgs...>*)
+    {
+        u8 index = 0;
+        ((std::is_same_v<Msg, Msgs> ? false : (++index, true)) && ...);
+        return index;
+    }
+
+    template <typename Msg>
+    constexpr std::byte MsgId()
+    {
+        return std::byte{ MsgIndex<Msg>((MsgBody*)nullptr) };
+    }
+
     struct NetPacket {
         MsgHeader header;
         MsgBody body;
     };
 
-    struct NetData {
-        NetAddress addr;
-        NetPacket pkt;
+    // received messages are read in place, their payloads point into the buffer the adapter handed over
+    // so parsing a packet doesnt copy or allocate. the layout on the wire matches the messages above.
+    struct InputMsgView {
+        Frame start_frame;
+        u16 input_count;
+        u16 total_size;
+        bool compressed;
+        InputAckMsg ack;
+
+        std::span<const u8> inputs;
+    };
+
+    struct DisconnectClaimMsgView {
+        Handle player;
+        Frame start_frame;
+        Frame last_frame;
+
+        std::span<const u8> inputs;
+    };
+
+    using MsgBodyView = std::variant<
+        InputMsgView,
+        InputAckMsg,
+        SyncMsg,
+        SessionHealthMsg,
+        NetworkHealthMsg,
+        DisconnectMsg,
+        DisconnectClaimMsgView
+    >;
+
+    struct NetPacketView {
+        MsgHeader header;
+        MsgBodyView body;
     };
 
     struct NetStats {
@@ -109,9 +179,12 @@ namespace Gekko {
         static const u64 SYNC_MSG_DELAY = 200;
         static const u64 NET_CHECK_DELAY = 500;
         static const u64 INPUT_RETRY_INTERVAL = 200;
+        static const u64 INPUT_RETRY_MARGIN = 10;
         static const u32 RTT_HISTORY_SIZE = 10;
 
         Frame last_acked_frame = -1;
+        // the frames past last_acked_frame the peer reported holding, see InputAckMsg::received.
+        u32 selective_acks = 0;
         u64 last_sent_sync_message = 0;
         u64 last_received_message = 0;
         u64 last_received_frame = 0;
@@ -122,17 +195,19 @@ namespace Gekko {
         u32 bytes_received_accum = 0;
         u64 last_bandwidth_update = 0;
 
-        std::vector<u16> rtt;
+        Vector<u16, MemNetwork> rtt;
 
         void AddRTT(u16 rtt_ms);
         void UpdateBandwidth();
         float CalculateJitter();
         float CalculateAvgRTT();
         u32 LastRTT();
+        // how long unacked inputs wait before theyre resent.
+        u64 InputRetryInterval();
     };
 
     struct NetInputData {
-        std::vector<Handle> handles;
+        Vector<Handle, MemNetwork> handles;
         InputMsg input;
     };
 }
@@ -10,37 +10,79 @@
 #include "event.h"
 #include "sync.h"
 #include "storage.h"
+#include "speculation.h"
+#include "timing.h"
+#include "memory.h"
 
 // define GekkoSession internally
 struct GekkoSession {
     virtual void Init(GekkoConfig* config) = 0;
     virtual void SetLocalDelay(i32 player, u8 delay) = 0;
+    virtual void SetAdaptiveDelay(GekkoAdaptiveDelay* settings) = 0;
     virtual void SetRunahead(u8 runahead) = 0;
+    virtual void SetRunaheadInstance(bool enabled) = 0;
+    virtual void SetAdaptiveRunahead(GekkoAdaptiveRunahead* settings) = 0;
+    virtual void ReportSimTime(u32 time_us) = 0;
+    virtual void SetCatchUp(u8 max_frames) = 0;
+    virtual void SetRollbackBudget(u8 frames) = 0;
+    virtual void SetPredictionWindow(u8 window) = 0;
+    virtual void SetAdaptivePredictionWindow(GekkoAdaptivePredictionWindow* settings) = 0;
     virtual void SetNetAdapter(GekkoNetAdapter* adapter) = 0;
     virtual i32 AddActor(GekkoPlayerType type, GekkoNetAddress* addr) = 0;
     virtual bool DisconnectActor(i32 actor) = 0;
     virtual void SetDisconnectTimeout(u32 timeout) = 0;
     virtual void AddLocalInput(i32 player, void* input) = 0;
+    virtual void* AcquireLocalInput(i32 player) = 0;
+    virtual void CommitLocalInputs() = 0;
     virtual GekkoGameEvent** UpdateSession(i32* count) = 0;
+    virtual void SetSimCallbacks(GekkoSimCallbacks* callbacks) = 0;
+    virtual void SetSpeculation(GekkoSpeculationCallbacks* callbacks, u8 num_branches) = 0;
     virtual GekkoSessionEvent** Events(i32* count) = 0;
     virtual f32 FramesAhead() = 0;
+    virtual i32 StartTime() = 0;
+    virtual void TimingAdvice(GekkoTimingAdvice* advice) = 0;
     virtual void NetworkStats(i32 player, GekkoNetworkStats* stats) = 0;
     virtual void NetworkPoll() = 0;
     virtual ~GekkoSession() = default;
+
+    // the context every allocation of this session is made from.
+    Gekko::MemContext* memory = nullptr;
 };
 
 namespace Gekko {
 
 	class GameSession : public GekkoSession {
     public:
+        // frames behind the peers on average before catching up kicks in.
+        static constexpr f32 CATCH_UP_THRESHOLD = 2.f;
+
+        // the most frames a lockstep session advances in a single update.
+        static constexpr u8 LOCKSTEP_MAX_FRAMES = 8;
+
         GameSession();
 
         void Init(GekkoConfig* config) override;
 
         void SetLocalDelay(i32 player, u8 delay) override;
 
+        void SetAdaptiveDelay(GekkoAdaptiveDelay* settings) override;
+
         void SetRunahead(u8 runahead) override;
 
+        void SetRunaheadInstance(bool enabled) override;
+
+        void SetAdaptiveRunahead(GekkoAdaptiveRunahead* settings) override;
+
+        void ReportSimTime(u32 time_us) override;
+
+        void SetCatchUp(u8 max_frames) override;
+
+        void SetRollbackBudget(u8 frames) override;
+
+        void SetPredictionWindow(u8 window) override;
+
+        void SetAdaptivePredictionWindow(GekkoAdaptivePredictionWindow* settings) override;
+
         void SetNetAdapter(GekkoNetAdapter* adapter) override;
 
         i32 AddActor(GekkoPlayerType type, GekkoNetAddress* addr) override;
@@ -51,12 +93,24 @@ namespace Gekko {
 
         void AddLocalInput(i32 player, void* input) override;
 
+        void* AcquireLocalInput(i32 player) override;
+
+        void CommitLocalInputs() override;
+
         GekkoGameEvent** UpdateSession(i32* count) override;
 
+        void SetSimCallbacks(GekkoSimCallbacks* callbacks) override;
+
+        void SetSpeculation(GekkoSpeculationCallbacks* callbacks, u8 num_branches) override;
+
         GekkoSessionEvent** Events(i32* count) override;
 
         f32 FramesAhead() override;
 
+        i32 StartTime() override;
+
+        void TimingAdvice(GekkoTimingAdvice* advice) override;
+
         void NetworkStats(i32 player, GekkoNetworkStats* stats) override;
 
         void NetworkPoll() override;
@@ -68,6 +122,22 @@ namespace Gekko {
 
 		void HandleReceivedInputs();
 
+		void UpdateTimeSync();
+
+		void AdaptToConditions();
+
+		void AdaptLocalDelay(u32 hits, u32 misses);
+
+		void AdaptRunahead(u32 hits, u32 misses);
+
+		void AdaptPredictionWindow();
+
+		void ApplyPredictionWindow();
+
+		bool IsPredictionExhausted();
+
+		void GetNetworkConditions(f32& rtt, f32& jitter);
+
 		void SendLocalInputs();
 
 		u8 GetMinLocalDelay();
@@ -76,10 +146,20 @@ namespace Gekko {
 
         bool IsLockstepActive() const;
 
+        bool IsSavingStates();
+
+        u32 MaxAdvanceEvents() const;
+
+        u32 MaxOtherEvents() const;
+
 		void AddDisconnectedPlayerInputs();
 
 		void SendSpectatorInputs();
 
+		void UpdateLocalSession();
+
+		void SaveInitialState();
+
 		void HandleRollback();
 
 		void HandleSavingConfirmedFrame();
@@ -88,14 +168,34 @@ namespace Gekko {
 
 		void RewindRunahead();
 
+		bool CanContinueRunahead(Frame start);
+
+		void AdoptRunaheadFrame();
+
+		void ReserveRunahead();
+
+		void HandleRunaheadInstance();
+
+		void HandleSpeculation();
+
+		bool AdoptSpeculation(Frame frame);
+
 		bool RollbackPending();
 
+		Frame GetRollbackStartFrame();
+
+		u8 GetRollbackBudget() const;
+
 		bool ConfirmedSaveDue();
 
 		Frame GetConfirmedFrame();
 
 		bool ShouldStallAdvance();
 
+		void HandleCatchUp();
+
+		void HandleLockstepAdvance();
+
         void SendSessionHealthCheck();
 
         void SendNetworkHealthCheck();
@@ -111,9 +211,33 @@ namespace Gekko {
 
 		Frame _runahead_start_frame;
 
+		// the last frame the previous runahead simulated up to.
+		Frame _runahead_end_frame;
+
+		// the runahead of the previous update still holds and is continued instead of redone.
+		bool _runahead_continued;
+
+		// run ahead on a second instance of the simulation, the previous runahead ran there
+		// and it has to be brought up to date from the primary one.
+		bool _runahead_instance;
+
+		bool _runahead_on_instance;
+
+		bool _runahead_instance_stale;
+
 		u8 _runahead_frames;
 
-		std::unique_ptr<u8[]> _disconnected_input;
+		u8 _rollback_budget;
+
+		u8 _catch_up_frames;
+
+		// the first frame still simulated with the old inputs while a budgeted rollback catches up.
+		Frame _resim_frame;
+
+		// the prediction window to switch to once the session isnt predicting past it.
+		u8 _target_window;
+
+		UniquePtr<u8[]> _disconnected_input;
 
 		GekkoConfig _config;
 
@@ -126,6 +250,23 @@ namespace Gekko {
 		StateStorage _storage;
 
         GameEventSystem _game_events;
+
+        SpeculationSystem _speculation;
+
+        TimeSync _time_sync;
+
+        DelayController _delay_control;
+
+        RunaheadController _runahead_control;
+
+        WindowController _window_control;
+
+        // the simulation time the game reported for the previous update and the advances it handled.
+        u32 _reported_sim_time;
+
+        bool _sim_time_reported;
+
+        u32 _last_advance_count;
 	};
 
 	class SpectatorSession : public GekkoSession {
@@ -136,8 +277,24 @@ namespace Gekko {
 
         void SetLocalDelay(i32 player, u8 delay) override;
 
+        void SetAdaptiveDelay(GekkoAdaptiveDelay* settings) override {}
+
         void SetRunahead(u8 runahead) override {}
 
+        void SetRunaheadInstance(bool enabled) override {}
+
+        void SetAdaptiveRunahead(GekkoAdaptiveRunahead* settings) override {}
+
+        void ReportSimTime(u32 time_us) override {}
+
+        void SetCatchUp(u8 max_frames) override {}
+
+        void SetRollbackBudget(u8 frames) override {}
+
+        void SetPredictionWindow(u8 window) override {}
+
+        void SetAdaptivePredictionWindow(GekkoAdaptivePredictionWindow* settings) override {}
+
         void SetNetAdapter(GekkoNetAdapter* adapter) override;
 
         i32 AddActor(GekkoPlayerType type, GekkoNetAddress* addr) override;
@@ -148,12 +305,24 @@ namespace Gekko {
 
         void AddLocalInput(i32 player, void* input) override;
 
+        void* AcquireLocalInput(i32 player) override;
+
+        void CommitLocalInputs() override;
+
         GekkoGameEvent** UpdateSession(i32* count) override;
 
+        void SetSimCallbacks(GekkoSimCallbacks* callbacks) override;
+
+        void SetSpeculation(GekkoSpeculationCallbacks* callbacks, u8 num_branches) override {}
+
         GekkoSessionEvent** Events(i32* count) override;
 
         f32 FramesAhead() override;
 
+        i32 StartTime() override;
+
+        void TimingAdvice(GekkoTimingAdvice* advice) override;
+
         void NetworkStats(i32 player, GekkoNetworkStats* stats) override;
 
         void NetworkPoll() override;
@@ -193,8 +362,24 @@ namespace Gekko {
 
         void SetLocalDelay(i32 player, u8 delay) override;
 
+        void SetAdaptiveDelay(GekkoAdaptiveDelay* settings) override {}
+
         void SetRunahead(u8 runahead) override {}
 
+        void SetRunaheadInstance(bool enabled) override {}
+
+        void SetAdaptiveRunahead(GekkoAdaptiveRunahead* settings) override {}
+
+        void ReportSimTime(u32 time_us) override {}
+
+        void SetCatchUp(u8 max_frames) override {}
+
+        void SetRollbackBudget(u8 frames) override {}
+
+        void SetPredictionWindow(u8 window) override {}
+
+        void SetAdaptivePredictionWindow(GekkoAdaptivePredictionWindow* settings) override {}
+
         void SetNetAdapter(GekkoNetAdapter* adapter) override;
 
         i32 AddActor(GekkoPlayerType type, GekkoNetAddress* addr) override;
@@ -205,12 +390,24 @@ namespace Gekko {
 
         void AddLocalInput(i32 player, void* input) override;
 
+        void* AcquireLocalInput(i32 player) override;
+
+        void CommitLocalInputs() override;
+
         GekkoGameEvent** UpdateSession(i32* count) override;
 
+        void SetSimCallbacks(GekkoSimCallbacks* callbacks) override;
+
+        void SetSpeculation(GekkoSpeculationCallbacks* callbacks, u8 num_branches) override {}
+
         GekkoSessionEvent** Events(i32* count) override;
 
         f32 FramesAhead() override;
 
+        i32 StartTime() override;
+
+        void TimingAdvice(GekkoTimingAdvice* advice) override;
+
         void NetworkStats(i32 player, GekkoNetworkStats* stats) override;
 
         void NetworkPoll() override;
@@ -231,10 +428,10 @@ namespace Gekko {
 
         GameEventSystem _game_events;
 
-        std::vector<Player> _locals;
+        Vector<Player> _locals;
 
         u32 _check_distance;
 
-        std::map<Frame, u32> _checksum_history;
+        Map<Frame, u32> _checksum_history;
     };
 }
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "gekkonet.h"
+#include "gekko_types.h"
+#include "storage.h"
+#include "memory.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace Gekko {
+    struct SpeculativeBranch {
+        UniquePtr<u8[]> state;
+
+        u32 state_len = 0;
+
+        u32 checksum = 0;
+
+        GekkoBranch desc = {};
+    };
+
+    // simulates alternative inputs for a single predicted frame on a pool of worker threads.
+    // the branches only ever see copies, the session thread hands them out and takes them back.
+    class SpeculationSystem {
+    public:
+        static const u8 MAX_BRANCHES = 16;
+
+        SpeculationSystem() = default;
+
+        ~SpeculationSystem();
+
+        SpeculationSystem(const SpeculationSystem&) = delete;
+        SpeculationSystem& operator=(const SpeculationSystem&) = delete;
+
+        void Init(GekkoSpeculationCallbacks* callbacks, u8 num_branches, u32 input_size, u32 state_size);
+
+        void Stop();
+
+        bool IsActive() const;
+
+        // the frame the branches are speculating on, NULL_FRAME when theres nothing to adopt.
+        Frame GetFrame() const;
+
+        // starts the branches for the frame after the given state using the hypotheses of the game.
+        void Launch(Frame frame, u8* predicted, StateEntry* base);
+
+        // copies the branch matching the real inputs into the given state, returns false when none did.
+        bool Adopt(Frame frame, u8* inputs, StateEntry* target);
+
+        void Discard();
+
+    private:
+        void Wait();
+
+        void WorkerLoop(u32 index, u32 generation);
+
+    private:
+        GekkoSpeculationCallbacks _callbacks = {};
+
+        u32 _input_size = 0;
+
+        u32 _state_size = 0;
+
+        Frame _frame = GameInput::NULL_FRAME;
+
+        u32 _num_hypotheses = 0;
+
+        // the state the branches start from.
+        UniquePtr<u8[]> _base_state;
+
+        u32 _base_len = 0;
+
+        // the input sets of all branches back to back, filled in by the game.
+        UniquePtr<u8[]> _hypotheses;
+
+        UniquePtr<SpeculativeBranch[]> _branches;
+
+        Vector<std::thread> _workers;
+
+        std::mutex _mutex;
+
+        std::condition_variable _wake;
+
+        std::condition_variable _done;
+
+        u32 _generation = 0;
+
+        u32 _running = 0;
+
+        bool _quit = false;
+    };
+}
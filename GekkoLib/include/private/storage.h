@@ -2,6 +2,7 @@
 
 #include "gekko_types.h"
 #include "input.h"
+#include "memory.h"
 
 #include <memory>
 #include <vector>
@@ -9,9 +10,13 @@
 namespace Gekko {
 	struct StateEntry {
 		Frame frame = GameInput::NULL_FRAME;
-		std::unique_ptr<u8[]> state;
+		// set once a state was written, the initial save sits at NULL_FRAME so the frame cant tell.
+		bool valid = false;
+		UniquePtr<u8[]> state;
 		u32 state_len = 0;
 		u32 checksum = 0;
+		// the inputs the state was simulated with, only kept for the frames ran ahead.
+		UniquePtr<u8[]> inputs;
 	};
 
 	class StateStorage {
@@ -20,15 +25,30 @@ namespace Gekko {
 
 		void Init(u32 num_states, u32 state_size, bool limited);
 
+		// resizes the ring for a new prediction window, the newest states are kept.
+		void Resize(u32 num_states);
+
 		StateEntry* GetState(Frame frame);
 
-		StateEntry* GetRunaheadState();
+		// grows the ring of states ran ahead to hold at least num_frames, the states in it are kept.
+		void ReserveRunahead(u32 num_frames, u32 input_size);
+
+		StateEntry* GetRunaheadState(Frame frame);
+
+		// takes over a state ran ahead once its frame got simulated with the same inputs for real.
+		void AdoptRunaheadState(Frame frame);
 
 	private:
 		u32 _max_num_states;
 
-		std::vector<std::unique_ptr<StateEntry>> _states;
+		u32 _state_size;
+
+		u32 _runahead_input_size;
+
+		bool _limited;
+
+		Vector<UniquePtr<StateEntry>, MemStorage> _states;
 
-		StateEntry _runahead_state;
+		Vector<UniquePtr<StateEntry>, MemStorage> _runahead_states;
 	};
 }
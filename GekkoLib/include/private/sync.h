@@ -15,19 +15,27 @@ namespace Gekko {
 
 		void AddLocalInput(Handle player, u8* input);
 
+		u8* AcquireLocalInput(Handle player);
+
+		void CommitLocalInput(Handle player);
+
 		void AddRemoteInput(Handle player, u8* input, Frame frame);
 
 		void OverwriteInput(Handle player, u8* input, Frame frame);
 
 		void IncrementFrame();
 
-		bool GetCurrentInputs(std::unique_ptr<u8[]>& inputs, Frame& frame);
+		// the inputs are only valid until the next call.
+		bool GetCurrentInputs(u8*& inputs, Frame& frame);
+
+		// the inputs of a frame that was already simulated, predictions included.
+		bool GetFrameInputs(u8*& inputs, Frame frame);
 
 		void SetRunaheadMode(bool running_ahead);
 
-		bool GetSpectatorInputs(std::unique_ptr<u8[]>& inputs, Frame frame);
+		bool GetSpectatorInputs(u8*& inputs, Frame frame);
 
-		bool GetLocalInput(Handle player, std::unique_ptr<u8[]>& input, Frame frame);
+		u8* GetLocalInput(Handle player, Frame frame);
 
 		void SetLocalDelay(Handle player, u8 delay);
 		
@@ -45,8 +53,15 @@ namespace Gekko {
 
         Frame GetLastReceivedFrom(Handle player);
 
+        void RepeatLocalInput(Handle player, Frame up_to);
+
+        void PadLocalInput(Handle player, Frame up_to);
+
         void ClearIncorrectFramesUpTo(Frame clear_limit);
 
+        // the verified predictions of all players since the last call.
+        void TakePredictionCounts(u32& hits, u32& misses);
+
 	private:
 		u8 _num_players;
 
@@ -54,6 +69,9 @@ namespace Gekko {
 
 		Frame _current_frame;
 
-		std::unique_ptr<InputBuffer[]> _input_buffers;
+		UniquePtr<InputBuffer[]> _input_buffers;
+
+		// the inputs of all players for a single frame.
+		UniquePtr<u8[]> _frame_inputs;
 	};
 }
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "gekkonet.h"
+#include "gekko_types.h"
+
+namespace Gekko {
+    // phase locked loop over the frame advantage towards the peers. instead of skipping frames
+    // the tick rate is slewed by a few percent until the peers run in step again.
+    class TimeSync {
+    public:
+        // the most the tick rate gets adjusted, small enough to go unnoticed.
+        static constexpr f32 MAX_SLEW = 0.02f;
+
+        static constexpr f32 DEFAULT_FRAME_TIME_US = 1000000.f / 60.f;
+
+        void Init();
+
+        // registers an update, the interval between updates drives the frame time estimate.
+        void OnUpdate(u64 now_us);
+
+        // the progress into the current frame in 1/256 frames.
+        u8 GetFramePhase(u64 now_us) const;
+
+        // feeds the filtered frames ahead of the peers and the round trip time to the loop.
+        void Update(f32 frames_ahead, f32 rtt_ms);
+
+        void GetAdvice(u64 now_us, GekkoTimingAdvice* advice) const;
+
+        // the measured frame time without the advised adjustment.
+        f32 GetFrameTime() const;
+
+        static u64 Now();
+
+    private:
+        f32 _frame_time_us = DEFAULT_FRAME_TIME_US;
+
+        u64 _last_update_us = 0;
+
+        // the tick rate multiplier that was in effect for the current frame.
+        f32 _scale = 1.f;
+
+        f32 _integrator = 0.f;
+
+        f32 _frames_ahead = 0.f;
+
+        u32 _num_intervals = 0;
+    };
+
+    // picks the local input delay from the network conditions so rollbacks stay around a target depth.
+    // changes are voted on over several intervals and the bounds for growing and shrinking are
+    // apart, so the delay doesnt flip back and forth on a borderline connection.
+    class DelayController {
+    public:
+        // frames between evaluations.
+        static const u32 EVAL_INTERVAL = 60;
+
+        // consecutive evaluations required before the delay changes.
+        static const u32 GROW_VOTES = 2;
+
+        static const u32 SHRINK_VOTES = 3;
+
+        void Init(GekkoAdaptiveDelay* settings);
+
+        void Disable();
+
+        bool IsActive() const;
+
+        void AddRollback(u32 depth);
+
+        // accounts a frame and returns the delay to continue with.
+        u8 Update(u8 delay, u32 hits, u32 misses, f32 rtt_ms, f32 jitter_ms, f32 frame_time_ms);
+
+    private:
+        bool _active = false;
+
+        GekkoAdaptiveDelay _settings = {};
+
+        u32 _frames = 0;
+
+        u32 _hits = 0;
+
+        u32 _misses = 0;
+
+        u32 _rollbacks = 0;
+
+        u32 _rollback_frames = 0;
+
+        // positive when the last evaluations asked for more delay, negative for less.
+        i32 _votes = 0;
+    };
+
+    // picks the runahead from the measured simulation cost and the prediction accuracy. it drops a frame
+    // as soon as the slowest update in an interval goes over the budget and only adds one back after
+    // steady headroom, so a single rollback spike doesnt keep toggling it.
+    class RunaheadController {
+    public:
+        // updates between evaluations.
+        static const u32 EVAL_INTERVAL = 30;
+
+        // consecutive evaluations with headroom required before raising the runahead.
+        static const u32 RAISE_VOTES = 2;
+
+        void Init(GekkoAdaptiveRunahead* settings);
+
+        void Disable();
+
+        bool IsActive() const;
+
+        // the runahead to reserve events for, 0 when inactive.
+        u8 GetMaxRunahead() const;
+
+        // the time an update spent on the simulation and the advances it took.
+        void AddSample(u32 time_us, u32 advances);
+
+        // accounts an update and returns the runahead to continue with.
+        u8 Update(u8 runahead, u32 hits, u32 misses);
+
+    private:
+        bool _active = false;
+
+        GekkoAdaptiveRunahead _settings = {};
+
+        u32 _updates = 0;
+
+        u32 _samples = 0;
+
+        u32 _hits = 0;
+
+        u32 _misses = 0;
+
+        // the slowest update of the current interval.
+        u32 _peak_us = 0;
+
+        // moving average of the cost of a single advance.
+        f32 _advance_us = 0.f;
+
+        u32 _votes = 0;
+    };
+
+    // sizes the prediction window to the one way latency past the local delay with a frame to spare.
+    // a stall on an exhausted window widens it at the next evaluation, it only narrows after the
+    // link stayed calm for several intervals.
+    class WindowController {
+    public:
+        // frames between evaluations.
+        static const u32 EVAL_INTERVAL = 60;
+
+        // consecutive evaluations asking for a narrower window before it shrinks.
+        static const u32 SHRINK_VOTES = 5;
+
+        void Init(GekkoAdaptivePredictionWindow* settings);
+
+        void Disable();
+
+        bool IsActive() const;
+
+        void AddStall();
+
+        // accounts a frame and returns the window to continue with.
+        u8 Update(u8 window, u8 delay, f32 rtt_ms, f32 jitter_ms, f32 frame_time_ms);
+
+    private:
+        bool _active = false;
+
+        GekkoAdaptivePredictionWindow _settings = {};
+
+        u32 _frames = 0;
+
+        u32 _stalls = 0;
+
+        u32 _votes = 0;
+    };
+}
@@ -1,5 +1,6 @@
 #include "backend.h"
 
+#include <bit>
 #include <cassert>
 #include <climits>
 #include <cstring>
@@ -11,6 +12,9 @@ Gekko::MessageSystem::MessageSystem()
     _num_players = 0;
 	_input_size = 0;
     _last_sent_network_check = 0;
+    _start_time = 0;
+    _output_count = 0;
+    _encode_clock = 0;
     _disconnect_timeout = NetStats::DISCONNECT_TIMEOUT;
 
 	// gen magic for session
@@ -27,14 +31,166 @@ void Gekko::MessageSystem::Init(u8 num_players, u32 input_size)
 
     _net_player_queue.resize(num_players);
 
+    // one slot more than the queue holds since inputs get trimmed after being added,
+    // plus the ones held past a gap.
+    for (auto& queue : _net_player_queue) {
+        queue.Init(_input_size, MAX_INPUT_QUEUE_SIZE + 1 + SACK_WINDOW);
+    }
+
+    _net_spectator_queue.Init(_input_size * _num_players, MAX_INPUT_QUEUE_SIZE + 1);
+
+    _players.assign(num_players, nullptr);
+
+    _encoded_inputs.resize(ENCODED_INPUT_CACHE_SIZE);
+}
+
+Gekko::Player* Gekko::MessageSystem::AddActor(Handle handle, GekkoPlayerType type, NetAddress* addr)
+{
+    auto& actors = type == GekkoLocalPlayer ? locals : type == GekkoRemotePlayer ? remotes : spectators;
+    actors.push_back(MakeUnique<Player>(handle, type, addr));
+
+    Player* actor = actors.back().get();
+
+    if (handle >= 0 && handle < (Handle)_players.size()) {
+        _players[handle] = actor;
+    }
+
+    if (type != GekkoLocalPlayer) {
+        actor->peer = _peers.Intern(&actor->address);
+        _peers.AddActor(actor->peer, actor);
+
+        if (actor->peer != PeerTable::INVALID_PEER && actor->peer >= (u32)_open_output.size()) {
+            _open_output.resize(actor->peer + 1, UINT32_MAX);
+        }
+    }
+
+    return actor;
+}
+
+
+u32 Gekko::PeerTable::Intern(NetAddress* addr)
+{
+    if (!addr || addr->GetSize() == 0) {
+        return INVALID_PEER;
+    }
+
+    const u32 found = Find(*addr);
+    if (found != INVALID_PEER) {
+        return found;
+    }
+
+    const u32 peer = (u32)_hashes.size();
+    _hashes.push_back(Hash(*addr));
+    _addresses.push_back(addr);
+    _actors.emplace_back();
+
+    if ((peer + 1) * 2 > (u32)_slots.size()) {
+        Rehash(std::max<u32>(8, (u32)_slots.size() * 2));
+    }
+    else {
+        Insert(peer);
+    }
+
+    return peer;
+}
+
+u32 Gekko::PeerTable::Find(NetAddress& addr)
+{
+    if (_slots.empty()) {
+        return INVALID_PEER;
+    }
+
+    const u64 hash = Hash(addr);
+    const u32 mask = (u32)_slots.size() - 1;
+
+    for (u32 i = (u32)hash & mask; ; i = (i + 1) & mask) {
+        const u32 peer = _slots[i];
+        if (peer == INVALID_PEER) {
+            return INVALID_PEER;
+        }
+
+        if (_hashes[peer] == hash && _addresses[peer]->Equals(addr)) {
+            return peer;
+        }
+    }
+}
+
+void Gekko::PeerTable::AddActor(u32 peer, Player* actor)
+{
+    if (peer < (u32)_actors.size()) {
+        _actors[peer].push_back(actor);
+    }
+}
+
+Gekko::Vector<Gekko::Player*, Gekko::MemNetwork>& Gekko::PeerTable::GetActors(u32 peer)
+{
+    return peer < (u32)_actors.size() ? _actors[peer] : _no_actors;
+}
+
+u64 Gekko::PeerTable::Hash(NetAddress& addr)
+{
+    // fnv-1a
+    u64 hash = 14695981039346656037ull;
+    const u8* data = addr.GetAddress();
+
+    for (u32 i = 0; i < addr.GetSize(); i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
 }
 
+void Gekko::PeerTable::Insert(u32 peer)
+{
+    const u32 mask = (u32)_slots.size() - 1;
+
+    u32 i = (u32)_hashes[peer] & mask;
+    while (_slots[i] != INVALID_PEER) {
+        i = (i + 1) & mask;
+    }
+
+    _slots[i] = peer;
+}
 
-bool Gekko::InputCache::IsValid(Frame current_ack, Frame current_last_input) const
+void Gekko::PeerTable::Rehash(u32 capacity)
 {
-    return !packets.empty()
-        && last_acked_frame == current_ack
-        && last_input_frame == current_last_input;
+    _slots.assign(capacity, INVALID_PEER);
+
+    for (u32 peer = 0; peer < (u32)_hashes.size(); peer++) {
+        Insert(peer);
+    }
+}
+
+void Gekko::MessageSystem::NetInputQueue::Init(u32 entry_size, u32 capacity)
+{
+    _entry_size = entry_size;
+    _capacity = capacity;
+    _storage = MakeUniqueArray<u8, MemInput>((size_t)_entry_size * _capacity);
+
+    last_added_input = -1;
+    received_ahead = 0;
+    inputs.clear();
+}
+
+u8* Gekko::MessageSystem::NetInputQueue::GetSlot(Frame frame)
+{
+    return _storage.get() + (size_t)(frame % _capacity) * _entry_size;
+}
+
+u32 Gekko::MessageSystem::NetInputQueue::ReceivedAfter(Frame frame) const
+{
+    if (frame > last_added_input) {
+        return 0;
+    }
+
+    // everything up to the last added input is in, past it only what waits ahead of a gap.
+    const u32 contiguous = (u32)(last_added_input - frame);
+    if (contiguous >= 32) {
+        return UINT32_MAX;
+    }
+
+    return ((1u << contiguous) - 1) | (received_ahead << contiguous);
 }
 
 void Gekko::MessageSystem::NetInputQueue::TrimToAck(Frame min_ack, u32 max_size)
@@ -57,18 +213,17 @@ void Gekko::MessageSystem::NetInputQueue::TrimToAck(Frame min_ack, u32 max_size)
     }
 }
 
-void Gekko::MessageSystem::AddInput(Frame input_frame, Handle player, u8 input[], bool remote)
+void Gekko::MessageSystem::AddInput(Frame input_frame, Handle player, u8 input[])
 {
     auto& input_q = _net_player_queue[player];
 	if (input_q.last_added_input + 1 == input_frame) {
         input_q.last_added_input++;
-        input_q.inputs.push_back(std::make_unique<u8[]>(_input_size));
-        std::memcpy(input_q.inputs.back().get(), input, _input_size);
+        // local inputs stay valid within the input buffer for longer than the queue holds them.
+        input_q.inputs.push_back(input);
 	}
 
-    // discard acked inputs (local) or just cap the queue (remote)
-    Frame min_ack = remote ? (Frame)INT_MAX : GetMinLastAckedFrame(false);
-    input_q.TrimToAck(min_ack, MAX_INPUT_QUEUE_SIZE);
+    // discard acked inputs
+    input_q.TrimToAck(GetMinLastAckedFrame(false), MAX_INPUT_QUEUE_SIZE);
 }
 
 void Gekko::MessageSystem::AddSpectatorInput(Frame input_frame, u8 input[])
@@ -76,9 +231,9 @@ void Gekko::MessageSystem::AddSpectatorInput(Frame input_frame, u8 input[])
     auto& input_q = _net_spectator_queue;
 	if (input_q.last_added_input + 1 == input_frame) {
         input_q.last_added_input++;
-        const size_t num_players = locals.size() + remotes.size();
-        input_q.inputs.push_back(std::make_unique<u8[]>(_input_size * num_players));
-        std::memcpy(input_q.inputs.back().get(), input, _input_size * num_players);
+        u8* slot = input_q.GetSlot(input_frame);
+        std::memcpy(slot, input, _input_size * _num_players);
+        input_q.inputs.push_back(slot);
 	}
 
     // discard acked inputs and cap the queue
@@ -90,7 +245,7 @@ void Gekko::MessageSystem::SendPendingOutput(GekkoNetAdapter* host)
 	// send per-peer input packets to remotes
 	if (!remotes.empty() && !locals.empty()) {
 		for (auto& peer : remotes) {
-			SendInputsToPeer(peer.get(), host, false);
+			SendInputsToPeer(peer.get(), false);
 		}
 	}
 	// check for disconnects (runs even in spectator sessions with no locals)
@@ -101,7 +256,7 @@ void Gekko::MessageSystem::SendPendingOutput(GekkoNetAdapter* host)
 	// send per-peer input packets to spectators
 	if (!spectators.empty() && !locals.empty()) {
 		for (auto& peer : spectators) {
-			SendInputsToPeer(peer.get(), host, true);
+			SendInputsToPeer(peer.get(), true);
 		}
 	}
 	// check for disconnects
@@ -115,39 +270,32 @@ void Gekko::MessageSystem::SendPendingOutput(GekkoNetAdapter* host)
 	// exchange input claims for disconnected players
 	SendPendingClaims();
 
-	// drain remaining messages (acks, sync, health, etc.)
-	while (!_pending_output.empty()) {
-		auto& pkt = _pending_output.front();
-        if ((pkt->pkt.header.type == SessionHealth || pkt->pkt.header.type == NetworkHealth) && pkt->addr.GetSize() == 0) {
-            // send to remotes
-            SendDataToAll(pkt.get(), host);
-            // send to spectators
-            SendDataToAll(pkt.get(), host, true);
-        }
-		else {
-			SendDataTo(pkt.get(), host);
-		}
-		_pending_output.pop();
-	}
+	// ack whatever didnt go out with the inputs above
+	SendPendingAcks();
+
+	// everything is serialized already, hand the datagrams over
+	FlushOutput(host);
 }
 
 void Gekko::MessageSystem::HandleData(GekkoNetAdapter* host, GekkoNetResult** data, u32 length)
 {
     for (u32 i = 0; i < length; i++) {
         auto res = data[i];
-        auto addr = NetAddress(res->addr.data, res->addr.size);
+        _recv_addr.Set(res->addr.data, res->addr.size);
 
-        _bin_buffer.clear();
-        _bin_buffer.insert(_bin_buffer.begin(), (u8*)res->data, (u8*)res->data + res->data_len);
+        // read the packet in place, payloads stay views into the adapters buffer until it is freed below.
+        zpp::bits::in in(std::span<const u8>((const u8*)res->data, res->data_len));
 
-        NetPacket pkt;
-        zpp::bits::in in(_bin_buffer);
+        // a datagram holds one message or a bundle of them back to back.
+        while (in.position() < res->data_len) {
+            const u32 msg_start = (u32)in.position();
 
-        if (failure(in(pkt.header, pkt.body))) {
-            printf("failed to deserialize packet\n");
-        }
-        else {
-            ParsePacket(addr, pkt, res->data_len);
+            if (failure(in(_recv_pkt.header, _recv_pkt.body))) {
+                printf("failed to deserialize packet\n");
+                break;
+            }
+
+            ParsePacket(_recv_addr, _recv_pkt, (u32)in.position() - msg_start);
         }
 
         // cleanup :)
@@ -157,66 +305,44 @@ void Gekko::MessageSystem::HandleData(GekkoNetAdapter* host, GekkoNetResult** da
     }
 }
 
-void Gekko::MessageSystem::SendSyncRequest(NetAddress* addr)
+void Gekko::MessageSystem::SendSyncRequest(u32 peer)
 {
-    if (!addr) {
-        return;
-    }
-
-    _pending_output.push(std::make_unique<NetData>());
-	auto& message = _pending_output.back();
-
-	message->addr.Copy(addr);
-
-	message->pkt.header.type = SyncRequest;
-	message->pkt.header.magic = 0;
-
     SyncMsg body = {};
     body.rng_data = _session_magic;
+    body.protocol_version = PROTOCOL_VERSION;
+    WriteSyncTimes(body, peer);
 
-    message->pkt.body = body;
+    QueueMessage(peer, SyncRequest, 0, body);
 }
 
-void Gekko::MessageSystem::SendSyncResponse(NetAddress* addr, u16 magic)
+void Gekko::MessageSystem::SendSyncResponse(u32 peer, u16 magic)
 {
-    if (!addr || magic == 0) {
+    if (magic == 0) {
         return;
     }
 
-    _pending_output.push(std::make_unique<NetData>());
-    auto& message = _pending_output.back();
-
-	message->addr.Copy(addr);
-	message->pkt.header.type = SyncResponse;
-	message->pkt.header.magic = magic;
-
     SyncMsg body = {};
     body.rng_data = _session_magic;
+    body.protocol_version = PROTOCOL_VERSION;
+    WriteSyncTimes(body, peer);
 
-    message->pkt.body = body;
+    QueueMessage(peer, SyncResponse, magic, body);
 }
 
-void Gekko::MessageSystem::SendDisconnect(NetAddress* addr, u16 magic)
+void Gekko::MessageSystem::SendDisconnect(u32 peer, u16 magic)
 {
-    if (!addr || magic == 0) {
+    if (magic == 0) {
         return;
     }
 
-    _pending_output.push(std::make_unique<NetData>());
-    auto& message = _pending_output.back();
-
-    message->addr.Copy(addr);
-    message->pkt.header.type = Disconnect;
-    message->pkt.header.magic = magic;
-
-    message->pkt.body = DisconnectMsg();
+    QueueMessage(peer, Disconnect, magic, DisconnectMsg());
 }
 
 void Gekko::MessageSystem::SendPendingDisconnects()
 {
     const u64 now = TimeSinceEpoch();
 
-    std::vector<std::unique_ptr<Player>>* current = &remotes;
+    Vector<UniquePtr<Player>>* current = &remotes;
     for (u32 i = 0; i < 2; i++)
     {
         if (i == 1) {
@@ -239,63 +365,96 @@ void Gekko::MessageSystem::SendPendingDisconnects()
                 continue;
             }
 
-            SendDisconnect(&actor->address, actor->session_magic);
+            SendDisconnect(actor->peer, actor->session_magic);
             actor->last_disconnect_msg_time = now;
             actor->disconnect_msgs_left--;
         }
     }
 }
 
-void Gekko::MessageSystem::SendInputAck(Handle player, Frame frame, i8 local_advantage)
+void Gekko::MessageSystem::QueueInputAck(Handle player, Frame frame, i8 local_advantage, u8 frame_phase)
 {
 	auto plyr = GetPlayerByHandle(player);
 
-    if (!plyr) {
+    if (!plyr || frame <= plyr->ack_frame) {
         return;
     }
 
-    _pending_output.push(std::make_unique<NetData>());
-    auto& message = _pending_output.back();
+    plyr->ack_frame = frame;
+    plyr->ack_advantage = local_advantage;
+    plyr->ack_phase = frame_phase;
+    plyr->ack_pending = true;
+}
 
-	message->addr.Copy(&plyr->address);
-	message->pkt.header.magic = plyr->session_magic;
-	message->pkt.header.type = InputAck;
+void Gekko::MessageSystem::SendPendingAcks()
+{
+    for (auto& player : remotes) {
+        if (!player->ack_pending || player->GetStatus() == Disconnected) {
+            continue;
+        }
 
-    InputAckMsg body = {};
-	body.ack_frame = frame;
-	body.frame_advantage = local_advantage;
+        InputAckMsg body = {};
+        if (!CollectInputAck(player->peer, body)) {
+            continue;
+        }
 
-    message->pkt.body = body;
+        QueueMessage(player->peer, InputAck, player->session_magic, body);
+    }
 }
 
-std::vector<Handle> Gekko::MessageSystem::GetRemoteHandlesForAddress(NetAddress* addr)
+bool Gekko::MessageSystem::CollectInputAck(u32 peer, InputAckMsg& ack)
 {
-	auto result = std::vector<Handle>();
-	for (auto& player: remotes) {
-		if (player->address.Equals(*addr)) {
+    bool pending = false;
+    Player* oldest = nullptr;
+
+    // the remote players behind one address send their inputs together, so ack the one furthest behind.
+    for (auto player : _peers.GetActors(peer)) {
+        if (player->GetType() != GekkoRemotePlayer) {
+            continue;
+        }
+        if (!oldest || player->ack_frame < oldest->ack_frame) {
+            oldest = player;
+        }
+        pending |= player->ack_pending;
+        player->ack_pending = false;
+    }
+
+    if (!oldest) {
+        ack = { -1, 0, 0, 0 };
+        return false;
+    }
+
+    ack.ack_frame = oldest->ack_frame;
+    ack.frame_advantage = oldest->ack_advantage;
+    ack.frame_phase = oldest->ack_phase;
+
+    // only report what arrived for every player behind the address.
+    ack.received = UINT32_MAX;
+    for (auto player : _peers.GetActors(peer)) {
+        if (player->GetType() == GekkoRemotePlayer) {
+            ack.received &= _net_player_queue[player->handle].ReceivedAfter(ack.ack_frame);
+        }
+    }
+    return pending;
+}
+
+void Gekko::MessageSystem::GetRemoteHandlesForPeer(u32 peer, Vector<Handle>& result)
+{
+	result.clear();
+	for (auto player : _peers.GetActors(peer)) {
+		if (player->GetType() == GekkoRemotePlayer) {
 			result.push_back(player->handle);
 		}
 	}
-	return result;
 }
 
 Gekko::Player* Gekko::MessageSystem::GetPlayerByHandle(Handle handle) 
 {
-    std::vector<std::unique_ptr<Player>>* current = &locals;
-    for (u32 i = 0; i < 2; i++)
-    {
-        if (i == 1) {
-            current = &remotes;
-        }
-
-        for (auto& player : *current) {
-            if (player->handle == handle) {
-                return player.get();
-            }
-        }
+    if (handle < 0 || handle >= (Handle)_players.size()) {
+        return nullptr;
     }
 
-	return nullptr;
+	return _players[handle];
 }
 
 Frame Gekko::MessageSystem::GetMinLastAckedFrame(bool spectator) 
@@ -326,7 +485,7 @@ bool Gekko::MessageSystem::CheckStatusActors()
 	i32 result = 0;
 	u64 now = TimeSinceEpoch();
 
-    std::vector<std::unique_ptr<Player>>* current = &remotes;
+    Vector<UniquePtr<Player>>* current = &remotes;
 
     for (u32 i = 0; i < 2; i++)
     {
@@ -337,11 +496,11 @@ bool Gekko::MessageSystem::CheckStatusActors()
             if (player->GetStatus() == Initiating) {
                 if (player->stats.last_sent_sync_message + NetStats::SYNC_MSG_DELAY < now) {
                     if (player->sync_num == 0) {
-                        SendSyncRequest(&player->address);
+                        SendSyncRequest(player->peer);
                         player->stats.last_sent_sync_message = now;
                     }
                     else if (player->sync_num < NUM_TO_SYNC) {
-                        SendSyncResponse(&player->address, player->session_magic);
+                        SendSyncResponse(player->peer, player->session_magic);
                         player->stats.last_sent_sync_message = now;
                     }
                     else {
@@ -355,9 +514,122 @@ bool Gekko::MessageSystem::CheckStatusActors()
         }
     }
 
+    // everyone is connected, propose when to begin and keep telling the peers until the session does.
+    if (result == 0) {
+        ProposeStart(MicrosSinceEpoch());
+    }
+
 	return result == 0;
 }
 
+u64 Gekko::MessageSystem::GetStartTime()
+{
+    if (_start_time == 0) {
+        return 0;
+    }
+
+    // every peer goes with the latest proposal, so they all end up on the same moment.
+    // that only holds once every proposal is in, a peer that finished connecting early would start on its own otherwise.
+    u64 result = _start_time;
+    for (auto& player : remotes) {
+        if (player->GetStatus() != Connected) {
+            continue;
+        }
+        if (player->start_time == 0) {
+            return 0;
+        }
+        result = std::max(result, std::min(player->start_time, _start_time + MAX_START_SKEW_US));
+    }
+
+    return result;
+}
+
+void Gekko::MessageSystem::ProposeStart(u64 now_us)
+{
+    // without remotes theres no one to agree with, begin right away.
+    if (remotes.empty()) {
+        if (_start_time == 0) {
+            _start_time = now_us;
+        }
+        return;
+    }
+
+    if (_start_time == 0) {
+        u64 max_rtt = 0;
+        for (auto& player : remotes) {
+            if (player->clock_rtt != UINT64_MAX) {
+                max_rtt = std::max(max_rtt, player->clock_rtt);
+            }
+            player->start_msgs_left = NUM_START_MSGS;
+        }
+
+        // leave the proposal time to reach the peers before it comes due.
+        _start_time = now_us + max_rtt * 2 + START_DELAY_US;
+    }
+
+    const u64 now = TimeSinceEpoch();
+
+    for (auto& player : remotes) {
+        if (player->GetStatus() != Connected) {
+            continue;
+        }
+
+        if (player->start_msgs_left > 0) {
+            player->start_msgs_left--;
+            SendSyncResponse(player->peer, player->session_magic);
+            player->stats.last_sent_sync_message = now;
+        }
+        // keep asking a peer whose proposal got lost, it answers with its own.
+        else if (player->start_time == 0 && player->stats.last_sent_sync_message + NetStats::SYNC_MSG_DELAY < now) {
+            SendSyncResponse(player->peer, player->session_magic);
+            player->stats.last_sent_sync_message = now;
+        }
+    }
+}
+
+void Gekko::MessageSystem::WriteSyncTimes(SyncMsg& body, u32 peer)
+{
+    body.transmit_time = MicrosSinceEpoch();
+    body.start_time = _start_time;
+
+    auto& actors = _peers.GetActors(peer);
+    if (!actors.empty()) {
+        body.origin_time = actors.front()->sync_remote_time;
+        body.receive_time = actors.front()->sync_receive_time;
+        body.awaiting_start = _start_time != 0 && actors.front()->start_time == 0;
+    }
+}
+
+void Gekko::MessageSystem::ReadSyncTimes(Player* player, SyncMsg* body, u64 now_us)
+{
+    // the peer echoed one of our timestamps along with when it got it, which gives a sample
+    // of the round trip and of the clock offset like ntp does.
+    if (body->origin_time != 0 && body->origin_time <= now_us && body->transmit_time >= body->receive_time) {
+        const u64 held = body->transmit_time - body->receive_time;
+        const u64 elapsed = now_us - body->origin_time;
+
+        if (elapsed >= held) {
+            const u64 rtt = elapsed - held;
+
+            // the quickest round trip is the one least skewed by queueing on the way.
+            if (rtt < player->clock_rtt) {
+                player->clock_rtt = rtt;
+                player->clock_offset = (((i64)body->receive_time - (i64)body->origin_time) +
+                    ((i64)body->transmit_time - (i64)now_us)) / 2;
+            }
+
+            player->stats.AddRTT((u16)std::min<u64>(rtt / 1000, UINT16_MAX));
+        }
+    }
+
+    player->sync_remote_time = body->transmit_time;
+    player->sync_receive_time = now_us;
+
+    if (body->start_time != 0 && player->clock_rtt != UINT64_MAX) {
+        player->start_time = (u64)((i64)body->start_time - player->clock_offset);
+    }
+}
+
 bool Gekko::MessageSystem::DisconnectActor(Handle handle)
 {
     // disconnecting a local actor means leaving the session, so drop every peer.
@@ -369,7 +641,7 @@ bool Gekko::MessageSystem::DisconnectActor(Handle handle)
 
             local->SetStatus(Disconnected);
 
-            std::vector<std::unique_ptr<Player>>* current = &remotes;
+            Vector<UniquePtr<Player>>* current = &remotes;
             for (u32 i = 0; i < 2; i++)
             {
                 if (i == 1) {
@@ -390,7 +662,7 @@ bool Gekko::MessageSystem::DisconnectActor(Handle handle)
     // find the requested remote actor or spectator.
     Player* target = nullptr;
 
-    std::vector<std::unique_ptr<Player>>* current = &remotes;
+    Vector<UniquePtr<Player>>* current = &remotes;
     for (u32 i = 0; i < 2; i++)
     {
         if (i == 1) {
@@ -419,7 +691,7 @@ bool Gekko::MessageSystem::DisconnectActor(Handle handle)
 
         for (auto& actor : *current) {
             const bool same_peer = actor.get() == target ||
-                (target->address.GetSize() != 0 && actor->address.Equals(target->address));
+                (target->peer != PeerTable::INVALID_PEER && actor->peer == target->peer);
 
             if (!same_peer) {
                 continue;
@@ -437,17 +709,11 @@ bool Gekko::MessageSystem::DisconnectActor(Handle handle)
 
 void Gekko::MessageSystem::SendSessionHealth(Frame frame, u32 checksum)
 {
-    _pending_output.push(std::make_unique<NetData>());
-    auto& message = _pending_output.back();
-
-    // the address and magic is set later so dont worry about it now
-    message->pkt.header.type = SessionHealth;
-
     SessionHealthMsg body = {};
     body.frame = frame;
     body.checksum = checksum;
 
-    message->pkt.body = body;
+    QueueMessageToAll(SessionHealth, body);
 }
 
 void Gekko::MessageSystem::SendNetworkHealth()
@@ -459,17 +725,11 @@ void Gekko::MessageSystem::SendNetworkHealth()
         return;
     }
 
-    _pending_output.push(std::make_unique<NetData>());
-    auto& message = _pending_output.back();
-
-    // the address and magic is set later so dont worry about it now
-    message->pkt.header.type = NetworkHealth;
-
     NetworkHealthMsg body = {};
     body.send_time = now;
     body.received = false;
 
-    message->pkt.body = body;
+    QueueMessageToAll(NetworkHealth, body);
 
     _last_sent_network_check = now;
 }
@@ -479,7 +739,7 @@ Frame Gekko::MessageSystem::GetLastAddedInputFrom(Handle player)
     return _net_player_queue[player].last_added_input;
 }
 
-std::deque<std::unique_ptr<u8[]>>& Gekko::MessageSystem::GetNetPlayerQueue(Handle player)
+Gekko::Deque<u8*, Gekko::MemInput>& Gekko::MessageSystem::GetNetPlayerQueue(Handle player)
 {
     return _net_player_queue[player].inputs;
 }
@@ -559,7 +819,7 @@ void Gekko::MessageSystem::SendPendingClaims()
         }
 
         // find the peers which have not heard or agreed to our current claim yet.
-        std::vector<Player*> pending;
+        Vector<Player*> pending;
         for (auto& peer : remotes) {
             if (peer->GetStatus() != Connected ||
                 peer->address.GetSize() == 0 || peer->session_magic == 0) {
@@ -591,18 +851,12 @@ void Gekko::MessageSystem::SendPendingClaims()
         body.last_frame = input_q.last_added_input;
         body.start_frame = body.last_frame - (Frame)input_q.inputs.size() + 1;
 
-        for (auto& input : input_q.inputs) {
-            body.inputs.insert(body.inputs.end(), input.get(), input.get() + _input_size);
+        for (auto input : input_q.inputs) {
+            body.inputs.insert(body.inputs.end(), input, input + _input_size);
         }
 
         for (auto peer : pending) {
-            _pending_output.push(std::make_unique<NetData>());
-            auto& message = _pending_output.back();
-
-            message->addr.Copy(&peer->address);
-            message->pkt.header.type = DisconnectClaim;
-            message->pkt.header.magic = peer->session_magic;
-            message->pkt.body = body;
+            QueueMessage(peer->peer, DisconnectClaim, peer->session_magic, body);
 
             peer->peer_claims_sent[actor->handle] = body.last_frame;
         }
@@ -654,102 +908,171 @@ u64 Gekko::MessageSystem::TimeSinceEpoch()
 	return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
 }
 
-void Gekko::MessageSystem::SendDataToAll(NetData* pkt, GekkoNetAdapter* host, bool spectators_only)
+u64 Gekko::MessageSystem::MicrosSinceEpoch()
 {
-    auto& actors = spectators_only ? spectators : remotes;
+	using namespace std::chrono;
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
 
-    std::vector<u8> body_buffer;
-    zpp::bits::out body_out(body_buffer);
+template <typename Msg>
+void Gekko::MessageSystem::QueueMessage(u32 peer, PacketType type, u16 magic, const Msg& body)
+{
+    if (peer == PeerTable::INVALID_PEER) {
+        return;
+    }
 
-    if (failure(body_out(pkt->pkt.body))) {
-        printf("failed to serialize packet body\n");
+    const MsgHeader header = { type, magic };
+
+    const u32 index = OpenOutput(peer);
+    auto& data = _output[index].data;
+    const u32 start = (u32)data.size();
+
+    zpp::bits::out out(data);
+    out.position() = start;
+
+    if (failure(out(header, MsgId<Msg>(), body))) {
+        printf("failed to serialize packet\n");
+        data.resize(start);
         return;
     }
 
-    for (auto& actor : actors) {
-        _bin_buffer.clear();
-        if (actor->address.GetSize() != 0 && actor->GetStatus() != Disconnected) {
+    CloseOutput(index, start);
+}
 
-            pkt->addr.Copy(&actor->address);
-            pkt->pkt.header.magic = actor->session_magic;
+template <typename Msg>
+void Gekko::MessageSystem::QueueMessageToAll(PacketType type, const Msg& body)
+{
+    _body_buffer.clear();
+    zpp::bits::out body_out(_body_buffer);
 
-            zpp::bits::out out(_bin_buffer);
-            if (failure(out(pkt->pkt.header))) {
-                printf("failed to serialize packet header\n");
+    if (failure(body_out(MsgId<Msg>(), body))) {
+        printf("failed to serialize packet body\n");
+        return;
+    }
+
+    for (auto actors : { &remotes, &spectators }) {
+        for (auto& actor : *actors) {
+            if (actor->address.GetSize() == 0 || actor->GetStatus() == Disconnected) {
                 continue;
             }
 
-            _bin_buffer.insert(
-                _bin_buffer.end(),
-                body_buffer.begin(),
-                body_buffer.end()
-            );
+            const MsgHeader header = { type, actor->session_magic };
+
+            const u32 index = OpenOutput(actor->peer);
+            auto& data = _output[index].data;
+            const u32 start = (u32)data.size();
 
-            auto addr = GekkoNetAddress();
-            addr.data = actor->address.GetAddress();
-            addr.size = actor->address.GetSize();
+            zpp::bits::out out(data);
+            out.position() = start;
 
-            host->send_data(&addr, (char*)_bin_buffer.data(), (int)_bin_buffer.size());
-            actor->stats.bytes_sent_accum += (u32)_bin_buffer.size();
+            if (failure(out(header))) {
+                printf("failed to serialize packet header\n");
+                data.resize(start);
+                continue;
+            }
+
+            data.insert(data.end(), _body_buffer.begin(), _body_buffer.end());
+            CloseOutput(index, start);
         }
     }
 }
 
-void Gekko::MessageSystem::SendDataTo(NetData* pkt, GekkoNetAdapter* host)
+u32 Gekko::MessageSystem::OpenOutput(u32 peer)
 {
-    _bin_buffer.clear();
+    if (!CanBundle(peer)) {
+        return AcquireOutput(peer);
+    }
 
-    zpp::bits::out out(_bin_buffer);
-    if (failure(out(pkt->pkt.header, pkt->pkt.body))) {
-        printf("failed to serialize packet\n");
+    if (_open_output[peer] == UINT32_MAX) {
+        _open_output[peer] = AcquireOutput(peer);
+    }
+
+    return _open_output[peer];
+}
+
+void Gekko::MessageSystem::CloseOutput(u32 index, u32 start)
+{
+    // a message that doesnt fit any datagram still goes out, just on its own.
+    if (start == 0 || _output[index].data.size() <= MAX_DATAGRAM_SIZE) {
         return;
     }
 
-    auto addr = GekkoNetAddress();
-    addr.data = pkt->addr.GetAddress();
-    addr.size = pkt->addr.GetSize();
+    const u32 peer = _output[index].peer;
+    const u32 next = AcquireOutput(peer);
 
-    host->send_data(&addr, (char*)_bin_buffer.data(), (int)_bin_buffer.size());
+    auto& full = _output[index].data;
+    _output[next].data.assign(full.begin() + start, full.end());
+    full.resize(start);
 
-    u32 sent_size = (u32)_bin_buffer.size();
-    std::vector<std::unique_ptr<Player>>* current = &remotes;
-    for (u32 i = 0; i < 2; i++)
-    {
-        if (i == 1) {
-            current = &spectators;
+    _open_output[peer] = next;
+}
+
+u32 Gekko::MessageSystem::AcquireOutput(u32 peer)
+{
+    // datagrams sent already are reused along with their buffers.
+    if (_output_count == (u32)_output.size()) {
+        _output.emplace_back();
+        _output.back().data.reserve(MAX_DATAGRAM_SIZE);
+    }
+
+    auto& buffer = _output[_output_count];
+    buffer.peer = peer;
+    buffer.data.clear();
+
+    return _output_count++;
+}
+
+void Gekko::MessageSystem::FlushOutput(GekkoNetAdapter* host)
+{
+    for (u32 i = 0; i < _output_count; i++) {
+        auto& buffer = _output[i];
+        auto& actors = _peers.GetActors(buffer.peer);
+
+        if (buffer.data.empty() || actors.empty()) {
+            continue;
         }
 
-        for (auto& actor : *current) {
-            if (actor->address.Equals(pkt->addr)) {
-                actor->stats.bytes_sent_accum += sent_size;
-            }
+        auto addr = GekkoNetAddress();
+        addr.data = actors.front()->address.GetAddress();
+        addr.size = actors.front()->address.GetSize();
+
+        host->send_data(&addr, (const char*)buffer.data.data(), (int)buffer.data.size());
+
+        for (auto actor : actors) {
+            actor->stats.bytes_sent_accum += (u32)buffer.data.size();
         }
     }
+
+    _output_count = 0;
+    std::fill(_open_output.begin(), _open_output.end(), UINT32_MAX);
 }
 
-void Gekko::MessageSystem::ParsePacket(NetAddress& addr, NetPacket& pkt, u32 packet_size)
+bool Gekko::MessageSystem::CanBundle(u32 peer)
 {
-    u64 now = TimeSinceEpoch();
-    // update receive timers.
-    std::vector<std::unique_ptr<Player>>* current = &remotes;
-    for (u32 i = 0; i < 2; i++)
-    {
-        if (i == 1) {
-            current = &spectators;
+    // the actors behind an address all run in the same session, any of them can tell.
+    for (auto actor : _peers.GetActors(peer)) {
+        if (actor->protocol_version >= BUNDLING_VERSION) {
+            return true;
         }
+    }
+    return false;
+}
 
-        for (auto& player : *current) {
-            if (player->address.Equals(addr)) {
-                player->stats.last_received_message = now;
-                player->stats.bytes_received_accum += packet_size;
-            }
-        }
+void Gekko::MessageSystem::ParsePacket(NetAddress& addr, NetPacketView& pkt, u32 packet_size)
+{
+    u64 now = TimeSinceEpoch();
+    const u32 peer = _peers.Find(addr);
+
+    // update receive timers.
+    for (auto player : _peers.GetActors(peer)) {
+        player->stats.last_received_message = now;
+        player->stats.bytes_received_accum += packet_size;
     }
 
     // handle packet.
     if (pkt.header.magic != _session_magic) {
         if (pkt.header.type == SyncRequest) {
-            OnSyncRequest(addr, pkt);
+            OnSyncRequest(peer, pkt);
         }
         else {
             printf("dropped packet!\n");
@@ -759,26 +1082,26 @@ void Gekko::MessageSystem::ParsePacket(NetAddress& addr, NetPacket& pkt, u32 pac
         switch (pkt.header.type)
         {
         case SyncResponse:
-            OnSyncResponse(addr, pkt);
+            OnSyncResponse(peer, pkt);
             return;
         case Inputs:
         case SpectatorInputs:
-            OnInputs(addr, pkt);
+            OnInputs(peer, pkt);
             return;
         case InputAck:
-            OnInputAck(addr, pkt);
+            OnInputAck(peer, pkt);
             return;
         case SessionHealth:
-            OnSessionHealth(addr, pkt);
+            OnSessionHealth(peer, pkt);
             return;
         case NetworkHealth:
-            OnNetworkHealth(addr, pkt);
+            OnNetworkHealth(peer, pkt);
             return;
         case Disconnect:
-            OnDisconnect(addr, pkt);
+            OnDisconnect(peer, pkt);
             return;
         case DisconnectClaim:
-            OnDisconnectClaim(addr, pkt);
+            OnDisconnectClaim(peer, pkt);
             return;
         default:
             assert(false && "cannot process an unknown event!");
@@ -787,10 +1110,11 @@ void Gekko::MessageSystem::ParsePacket(NetAddress& addr, NetPacket& pkt, u32 pac
     }
 }
 
-void Gekko::MessageSystem::OnSyncRequest(NetAddress& addr, NetPacket& pkt)
+void Gekko::MessageSystem::OnSyncRequest(u32 peer, NetPacketView& pkt)
 {
     i32 should_send = 0;
     u64 now = TimeSinceEpoch();
+    const u64 now_us = MicrosSinceEpoch();
     auto body = std::get_if<SyncMsg>(&pkt.body);
 
     if (!body) {
@@ -798,34 +1122,27 @@ void Gekko::MessageSystem::OnSyncRequest(NetAddress& addr, NetPacket& pkt)
     }
 
     // handle requests and set the peer its session magic for both remotes and spectators
-    std::vector<std::unique_ptr<Player>>* current = &remotes;
-    for (u32 i = 0; i < 2; i++)
-    {
-        if (i == 1) {
-            current = &spectators;
-        }
-
-        for (auto& player : *current) {
-            if (player->address.Equals(addr)) {
-                player->session_magic = body->rng_data;
-                if (player->sync_num == 0) {
-                    player->stats.last_sent_sync_message = now;
-                    should_send++;
-                }
-            }
+    for (auto player : _peers.GetActors(peer)) {
+        ReadSyncTimes(player, body, now_us);
+        player->protocol_version = body->protocol_version;
+        player->session_magic = body->rng_data;
+        if (player->sync_num == 0) {
+            player->stats.last_sent_sync_message = now;
+            should_send++;
         }
     }
 
     if (should_send > 0) {
 	    // send a packet containing the local session magic
-	    SendSyncResponse(&addr, body->rng_data);
+	    SendSyncResponse(peer, body->rng_data);
     }
 }
 
-void Gekko::MessageSystem::OnSyncResponse(NetAddress& addr, NetPacket& pkt)
+void Gekko::MessageSystem::OnSyncResponse(u32 peer, NetPacketView& pkt)
 {
     i32 should_send = 0;
     u64 now = TimeSinceEpoch();
+    const u64 now_us = MicrosSinceEpoch();
     auto body = std::get_if<SyncMsg>(&pkt.body);
 
     if (!body) {
@@ -833,63 +1150,59 @@ void Gekko::MessageSystem::OnSyncResponse(NetAddress& addr, NetPacket& pkt)
     }
 
     // handle sync responses for both remotes and spectators
-    std::vector<std::unique_ptr<Player>>* current = &remotes;
-    for (u32 i = 0; i < 2; i++)
-    {
-        if (i == 1) {
-            current = &spectators;
-        }
-
-        for (auto& player : *current) {
-            if (player->GetStatus() == Connected) {
-                // connected but the remote is still asking ? maybe high packet loss? send a response again
+    for (auto player : _peers.GetActors(peer)) {
+        ReadSyncTimes(player, body, now_us);
+        player->protocol_version = body->protocol_version;
+
+        if (player->GetStatus() == Connected) {
+            // connected but the remote is still asking ? maybe high packet loss? send a response again
+            // a peer proposing a start is done connecting already and only tells when,
+            // unless it is still waiting on our proposal.
+            if (body->start_time == 0 || body->awaiting_start) {
                 should_send++;
-                continue;
             }
+            continue;
+        }
 
-            if (player->address.Equals(addr)) {
-                player->session_magic = body->rng_data;
-                if (player->sync_num < NUM_TO_SYNC) {
-                    player->sync_num++;
-                    should_send++;
-                    player->stats.last_sent_sync_message = now;
-                    session_events.AddPlayerSyncingEvent(
-                        player->handle,
-                        player->sync_num,
-                        NUM_TO_SYNC
-                    );
-                    continue;
-                }
-
-                if (player->sync_num >= NUM_TO_SYNC) {
-                    player->SetStatus(Connected);
-                    session_events.AddPlayerConnectedEvent(player->handle);
-                    continue;
-                }
-            }
+        player->session_magic = body->rng_data;
+        if (player->sync_num < NUM_TO_SYNC) {
+            player->sync_num++;
+            should_send++;
+            player->stats.last_sent_sync_message = now;
+            session_events.AddPlayerSyncingEvent(
+                player->handle,
+                player->sync_num,
+                NUM_TO_SYNC
+            );
+            continue;
         }
+
+        player->SetStatus(Connected);
+        session_events.AddPlayerConnectedEvent(player->handle);
     }
 
     if (should_send > 0) {
     	// send a packet containing the local session magic
-    	SendSyncResponse(&addr, body->rng_data);
+    	SendSyncResponse(peer, body->rng_data);
     }
 }
 
-void Gekko::MessageSystem::OnInputs(NetAddress& addr, NetPacket& pkt)
+void Gekko::MessageSystem::OnInputs(u32 peer, NetPacketView& pkt)
 {
-    auto body = std::get_if<InputMsg>(&pkt.body);
+    auto body = std::get_if<InputMsgView>(&pkt.body);
 
     if (!body) {
         return;
     }
 
-    // RLE decompress if the sender compressed this packet
-    if (body->compressed) {
-        auto decompressed = Compression::RLEDecode(body->inputs.data(), (u32)body->inputs.size());
-        body->inputs = std::move(decompressed);
+    // the sender acks our inputs along with its own
+    if (body->ack.ack_frame >= 0) {
+        ApplyInputAck(peer, body->ack);
     }
 
+    // inputs are RLE decoded on the fly if the sender compressed this packet
+    Compression::Reader reader(body->inputs, body->compressed);
+
     const Frame start_frame = body->start_frame;
     const u32 input_count = body->input_count;
 
@@ -898,24 +1211,24 @@ void Gekko::MessageSystem::OnInputs(NetAddress& addr, NetPacket& pkt)
     if (is_spectator) {
         for (u32 frame_idx = 0; frame_idx < input_count; frame_idx++) {
             const Frame recv_frame = start_frame + frame_idx;
-            const u32 frame_offset = frame_idx * _num_players * _input_size;
 
             for (u32 player = 0; player < _num_players; player++) {
-                u8* input = &body->inputs[frame_offset + player * _input_size];
-                AddInput(recv_frame, player, input, true);
+                if (!ReadRemoteInput(recv_frame, player, reader)) {
+                    return;
+                }
             }
         }
     } else {
-        auto handles = GetRemoteHandlesForAddress(&addr);
+        GetRemoteHandlesForPeer(peer, _addr_handles);
+        const auto& handles = _addr_handles;
         const u32 player_count = (u32)handles.size();
 
         for (u32 i = 0; i < player_count; i++) {
-            const u32 player_offset = i * input_count * _input_size;
-
             for (u32 frame_idx = 0; frame_idx < input_count; frame_idx++) {
                 const Frame recv_frame = start_frame + frame_idx;
-                u8* input = &body->inputs[player_offset + frame_idx * _input_size];
-                AddInput(recv_frame, handles[i], input, true);
+                if (!ReadRemoteInput(recv_frame, handles[i], reader)) {
+                    return;
+                }
             }
 
             auto player = GetPlayerByHandle(handles[i]);
@@ -926,7 +1239,43 @@ void Gekko::MessageSystem::OnInputs(NetAddress& addr, NetPacket& pkt)
     }
 }
 
-void Gekko::MessageSystem::OnInputAck(NetAddress& addr, NetPacket& pkt)
+bool Gekko::MessageSystem::ReadRemoteInput(Frame input_frame, Handle player, Compression::Reader& reader)
+{
+    auto& input_q = _net_player_queue[player];
+    const Frame offset = input_frame - (input_q.last_added_input + 1);
+
+    // inputs we already have or that are too far ahead to hold are only skipped over.
+    if (offset < 0 || offset >= (Frame)SACK_WINDOW || (input_q.received_ahead & (1u << offset))) {
+        return reader.Skip(_input_size);
+    }
+
+    if (!reader.Read(input_q.GetSlot(input_frame), _input_size)) {
+        return false;
+    }
+
+    input_q.received_ahead |= 1u << offset;
+
+    // let the sender know what arrived past the gap so it only resends whats missing.
+    if (offset > 0) {
+        auto plyr = GetPlayerByHandle(player);
+        if (plyr) {
+            plyr->ack_pending = true;
+        }
+    }
+
+    // add every input that lines up now
+    while (input_q.received_ahead & 1u) {
+        input_q.last_added_input++;
+        input_q.inputs.push_back(input_q.GetSlot(input_q.last_added_input));
+        input_q.received_ahead >>= 1;
+
+        // just cap the queue, remote inputs arent acked from here
+        input_q.TrimToAck((Frame)INT_MAX, MAX_INPUT_QUEUE_SIZE);
+    }
+    return true;
+}
+
+void Gekko::MessageSystem::OnInputAck(u32 peer, NetPacketView& pkt)
 {
     auto body = std::get_if<InputAckMsg>(&pkt.body);
 
@@ -934,24 +1283,37 @@ void Gekko::MessageSystem::OnInputAck(NetAddress& addr, NetPacket& pkt)
         return;
     }
 
-    const Frame ack_frame = body->ack_frame;
-    const i8 remote_advantage = (i8)body->frame_advantage;
+    ApplyInputAck(peer, *body);
+}
 
-    for (auto& player : remotes) {
-        if (player->address.Equals(addr) && player->stats.last_acked_frame < ack_frame) {
-            player->stats.last_acked_frame = ack_frame;
-            player->adv_history.SetRemoteAdvantage(remote_advantage);
+void Gekko::MessageSystem::ApplyInputAck(u32 peer, const InputAckMsg& ack)
+{
+    const Frame ack_frame = ack.ack_frame;
+    const i8 remote_advantage = (i8)ack.frame_advantage;
+
+    for (auto player : _peers.GetActors(peer)) {
+        // acks can arrive out of order, a selective ack for the same frame only adds to the last one.
+        if (player->stats.last_acked_frame == ack_frame) {
+            player->stats.selective_acks |= ack.received;
+            continue;
         }
-    }
 
-    for (auto& player : spectators) {
-        if (player->address.Equals(addr) && player->stats.last_acked_frame < ack_frame) {
-            player->stats.last_acked_frame = ack_frame;
+        if (player->stats.last_acked_frame > ack_frame) {
+            continue;
+        }
+
+        player->stats.last_acked_frame = ack_frame;
+        player->stats.selective_acks = ack.received;
+
+        // spectators dont send inputs, so theres no advantage to track.
+        if (player->GetType() == GekkoRemotePlayer) {
+            player->adv_history.SetRemoteAdvantage(remote_advantage);
+            player->adv_history.AddRemoteArrival(remote_advantage + ack.frame_phase / 256.f);
         }
     }
 }
 
-void Gekko::MessageSystem::OnSessionHealth(NetAddress& addr, NetPacket& pkt)
+void Gekko::MessageSystem::OnSessionHealth(u32 peer, NetPacketView& pkt)
 {
     auto body = std::get_if<SessionHealthMsg>(&pkt.body);
 
@@ -962,8 +1324,8 @@ void Gekko::MessageSystem::OnSessionHealth(NetAddress& addr, NetPacket& pkt)
     const Frame frame = body->frame;
     const u32 checksum = body->checksum;
 
-    for (auto& player : remotes) {
-        if (player->address.Equals(addr)) {
+    for (auto player : _peers.GetActors(peer)) {
+        if (player->GetType() == GekkoRemotePlayer) {
             player->SetChecksum(frame, checksum);
 
             for (auto iter = player->session_health.begin();
@@ -979,7 +1341,7 @@ void Gekko::MessageSystem::OnSessionHealth(NetAddress& addr, NetPacket& pkt)
     }
 }
 
-void Gekko::MessageSystem::OnNetworkHealth(NetAddress& addr, NetPacket& pkt)
+void Gekko::MessageSystem::OnNetworkHealth(u32 peer, NetPacketView& pkt)
 {
     auto body = std::get_if<NetworkHealthMsg>(&pkt.body);
 
@@ -989,61 +1351,30 @@ void Gekko::MessageSystem::OnNetworkHealth(NetAddress& addr, NetPacket& pkt)
 
     // ok if its not a returned packet then update it and send it back to its specifc peer.
     if (!body->received) {
-        // find the sender in remotes or spectators
-        Player* player = nullptr;
-        auto handles = GetRemoteHandlesForAddress(&addr);
-        if (!handles.empty()) {
-            player = GetPlayerByHandle(handles.at(0));
-        }
-
-        // check spectators if not found in remotes
-        if (!player) {
-            for (auto& spec : spectators) {
-                if (spec->address.Equals(addr)) {
-                    player = spec.get();
-                    break;
-                }
-            }
-        }
-
-        if (!player) {
+        // find the sender in remotes or spectators, they share the session magic of the peer.
+        auto& actors = _peers.GetActors(peer);
+        if (actors.empty()) {
             return;
         }
 
-        _pending_output.push(std::make_unique<NetData>());
-        auto& message = _pending_output.back();
-
-        message->pkt.header.magic = player->session_magic;
-        message->pkt.header.type = NetworkHealth;
+        Player* player = actors.front();
 
         NetworkHealthMsg new_body = {};
         new_body.send_time = body->send_time;
         new_body.received = true;
 
-        message->pkt.body = new_body;
-        message->addr.Copy(&addr);
+        QueueMessage(peer, NetworkHealth, player->session_magic, new_body);
         return;
     }
 
     // else update network stats
     u16 rtt_ms = (u16)(TimeSinceEpoch() - body->send_time);
-    std::vector<std::unique_ptr<Player>>* current = &remotes;
-
-    for (u32 i = 0; i < 2; i++)
-    {
-        if (i == 1) {
-            current = &spectators;
-        }
-
-        for (auto& actor : *current) {
-            if (addr.Equals(actor->address)) {
-                actor->stats.AddRTT(rtt_ms);
-            }
-        }
+    for (auto actor : _peers.GetActors(peer)) {
+        actor->stats.AddRTT(rtt_ms);
     }
 }
 
-void Gekko::MessageSystem::OnDisconnect(NetAddress& addr, NetPacket& pkt)
+void Gekko::MessageSystem::OnDisconnect(u32 peer, NetPacketView& pkt)
 {
     auto body = std::get_if<DisconnectMsg>(&pkt.body);
 
@@ -1052,24 +1383,16 @@ void Gekko::MessageSystem::OnDisconnect(NetAddress& addr, NetPacket& pkt)
     }
 
     // the peer at this address left the session, so every actor it hosts is gone.
-    std::vector<std::unique_ptr<Player>>* current = &remotes;
-    for (u32 i = 0; i < 2; i++)
-    {
-        if (i == 1) {
-            current = &spectators;
-        }
-
-        for (auto& player : *current) {
-            if (player->address.Equals(addr) && player->GetStatus() != Disconnected) {
-                MarkActorDisconnected(player.get());
-            }
+    for (auto player : _peers.GetActors(peer)) {
+        if (player->GetStatus() != Disconnected) {
+            MarkActorDisconnected(player);
         }
     }
 }
 
-void Gekko::MessageSystem::OnDisconnectClaim(NetAddress& addr, NetPacket& pkt)
+void Gekko::MessageSystem::OnDisconnectClaim(u32 peer, NetPacketView& pkt)
 {
-    auto body = std::get_if<DisconnectClaimMsg>(&pkt.body);
+    auto body = std::get_if<DisconnectClaimMsgView>(&pkt.body);
 
     if (!body || body->player < 0 || body->player >= _num_players) {
         return;
@@ -1093,9 +1416,9 @@ void Gekko::MessageSystem::OnDisconnectClaim(NetAddress& addr, NetPacket& pkt)
     }
 
     // remember what the peer claimed so the exchange can settle.
-    for (auto& peer : remotes) {
-        if (peer->address.Equals(addr)) {
-            peer->peer_claims[body->player] = body->last_frame;
+    for (auto actor : _peers.GetActors(peer)) {
+        if (actor->GetType() == GekkoRemotePlayer) {
+            actor->peer_claims[body->player] = body->last_frame;
         }
     }
 
@@ -1119,9 +1442,9 @@ void Gekko::MessageSystem::OnDisconnectClaim(NetAddress& addr, NetPacket& pkt)
         return;
     }
 
-    for (Frame frame = std::max(next, body->start_frame); frame <= body->last_frame; frame++) {
-        u8* input = &body->inputs[(frame - body->start_frame) * _input_size];
-        AddInput(frame, body->player, input, true);
+    Compression::Reader reader(body->inputs, false);
+    for (Frame frame = body->start_frame; frame <= body->last_frame; frame++) {
+        ReadRemoteInput(frame, body->player, reader);
     }
 
     plyr->disconnect_frame = _net_player_queue[body->player].last_added_input;
@@ -1130,7 +1453,7 @@ void Gekko::MessageSystem::OnDisconnectClaim(NetAddress& addr, NetPacket& pkt)
     plyr->last_claim_sent_time = 0;
 }
 
-void Gekko::MessageSystem::SendInputsToPeer(Player* peer, GekkoNetAdapter* host, bool spectator)
+void Gekko::MessageSystem::SendInputsToPeer(Player* peer, bool spectator)
 {
     if (peer->address.GetSize() == 0 || peer->GetStatus() == Disconnected) {
         return;
@@ -1140,7 +1463,7 @@ void Gekko::MessageSystem::SendInputsToPeer(Player* peer, GekkoNetAdapter* host,
     const auto packet_type = spectator ? SpectatorInputs : Inputs;
     auto& queue = spectator ? _net_spectator_queue : _net_player_queue[locals[0]->handle];
     const u32 num_players = spectator ? _num_players : (u32)locals.size();
-    const u32 inputs_per_packet = MAX_INPUT_SIZE / (_input_size * num_players);
+    const Frame inputs_per_packet = (Frame)std::max(MAX_INPUT_SIZE / (_input_size * num_players), 1u);
     const u32 q_size = (u32)queue.inputs.size();
 
     if (q_size == 0) return;
@@ -1151,93 +1474,153 @@ void Gekko::MessageSystem::SendInputsToPeer(Player* peer, GekkoNetAdapter* host,
     // peer is caught up, nothing to send
     if (peer->stats.last_acked_frame >= last_input) return;
 
-    // check per-peer cache
-    if (peer->input_cache.IsValid(peer->stats.last_acked_frame, last_input)) {
-        // cache hit: nothing new to send, this is a pure re-send — rate limit it
-        const u64 now = TimeSinceEpoch();
-        if (peer->last_input_send_time + NetStats::INPUT_RETRY_INTERVAL > now) {
-            return;
+    const Frame last_acked = peer->stats.last_acked_frame;
+    const u32 selective_acks = peer->stats.selective_acks;
+    const u64 now = TimeSinceEpoch();
+
+    auto& sent = peer->input_send;
+
+    auto is_held = [&](Frame frame) {
+        const Frame offset = frame - (last_acked + 1);
+        return offset >= 0 && offset < 32 && (selective_acks & (1u << offset));
+    };
+
+    const u64 retry_interval = peer->stats.InputRetryInterval();
+    const u64 rtt = peer->stats.rtt.empty() ? retry_interval : (u64)peer->stats.CalculateAvgRTT();
+    // frames before the newest one the peer holds were lost on the way.
+    const Frame newest_held = last_acked + (Frame)std::bit_width(selective_acks);
+
+    // new frames go out along with the few unacked ones before them so a single lost datagram doesnt cost
+    // a round trip, a frame reported missing is resent once it had a round trip to arrive
+    // and any other unacked frame only after the retry interval.
+    const bool has_new_frames = queue.last_added_input > sent.last_sent_frame;
+    auto should_send = [&](Frame frame) {
+        if (is_held(frame)) return false;
+        if (frame > sent.last_sent_frame) return true;
+        if (has_new_frames && frame > sent.last_sent_frame - (Frame)INPUT_REDUNDANCY) return true;
+        const u64 age = now - sent.send_times[frame % InputSendState::HISTORY_SIZE];
+        return age >= (frame < newest_held ? rtt : retry_interval);
+    };
+
+    const Frame peer_start_frame = std::max(last_acked + 1, queue_oldest_frame);
+
+    sent.ranges.clear();
+    Frame frame = peer_start_frame;
+    while (frame <= queue.last_added_input) {
+        if (!should_send(frame)) {
+            frame++;
+            continue;
         }
-        for (const auto& cached_msg : peer->input_cache.packets) {
-            NetData data;
-            data.addr.Copy(&peer->address);
-            data.pkt.header.type = packet_type;
-            data.pkt.header.magic = peer->session_magic;
-            data.pkt.body = cached_msg;
 
-            SendDataTo(&data, host);
+        // spectators can be many, so a resend right after their ack starts on an aligned frame to share the packet,
+        // the few frames they hold already are skipped on their end. input packets to remote players start right
+        // after the ack, aligning those would only resend frames the peer already has.
+        Frame start = frame;
+        if (spectator && frame == peer_start_frame && frame <= sent.last_sent_frame) {
+            const Frame aligned = std::max(frame - frame % (Frame)INPUT_PACKET_ALIGNMENT, queue_oldest_frame);
+            if (aligned / inputs_per_packet == frame / inputs_per_packet) {
+                start = aligned;
+            }
         }
-        peer->last_input_send_time = now;
-        return;
+
+        // packets end on multiples of their capacity, which lines up the ranges of different peers as well
+        const Frame packet_end = (start / inputs_per_packet + 1) * inputs_per_packet;
+
+        Frame end = frame + 1;
+        while (end <= queue.last_added_input && end < packet_end && should_send(end)) {
+            end++;
+        }
+
+        sent.ranges.push_back({ start, (u32)(end - start) });
+        frame = end;
     }
 
-    // cache miss: rebuild packets for this peer
-    const Frame peer_start_frame = std::max(peer->stats.last_acked_frame + 1, queue_oldest_frame);
-    const u32 peer_start_idx = (u32)(peer_start_frame - queue_oldest_frame);
-    const u32 peer_input_count = q_size - peer_start_idx;
+    for (auto& range : sent.ranges) {
+        for (Frame i = range.start_frame; i < range.start_frame + (Frame)range.count; i++) {
+            sent.send_times[i % InputSendState::HISTORY_SIZE] = now;
+        }
+    }
+    sent.last_sent_frame = std::max(sent.last_sent_frame, queue.last_added_input);
 
-    if (peer_input_count == 0) return;
+    if (sent.ranges.empty()) return;
 
-    peer->input_cache.packets.clear();
+    // the ack is only taken once the inputs actually go out, spectators dont send inputs to ack.
+    InputAckMsg ack = { -1, 0, 0, 0 };
+    if (!spectator) {
+        CollectInputAck(peer->peer, ack);
+    }
 
-    const u32 packet_count = (peer_input_count + inputs_per_packet - 1) / inputs_per_packet;
+    for (auto& range : sent.ranges) {
+        InputMsg& msg = GetEncodedInputs(spectator, range.start_frame, range.count);
+        msg.ack = ack;
+        QueueMessage(peer->peer, packet_type, peer->session_magic, msg);
+    }
+}
 
-    for (u32 pc = 0; pc < packet_count; pc++) {
-        const u32 input_start_idx = peer_start_idx + pc * inputs_per_packet;
-        const u32 input_end_idx = std::min(peer_start_idx + peer_input_count, input_start_idx + inputs_per_packet);
-        const u32 input_count = input_end_idx - input_start_idx;
+Gekko::InputMsg& Gekko::MessageSystem::GetEncodedInputs(bool spectator, Frame start_frame, u32 count)
+{
+    _encode_clock++;
 
-        InputMsg msg;
-        msg.start_frame = queue_oldest_frame + input_start_idx;
+    EncodedInputs* oldest = nullptr;
+    for (auto& entry : _encoded_inputs) {
+        if (entry.count == count && entry.start_frame == start_frame && entry.spectator == spectator) {
+            entry.last_used = _encode_clock;
+            return entry.msg;
+        }
+        if (!oldest || entry.last_used < oldest->last_used) {
+            oldest = &entry;
+        }
+    }
 
-        if (spectator) {
+    auto& queue = spectator ? _net_spectator_queue : _net_player_queue[locals[0]->handle];
+    const u32 num_players = spectator ? _num_players : (u32)locals.size();
+    const Frame queue_oldest_frame = queue.last_added_input - (Frame)queue.inputs.size() + 1;
+
+    const u32 input_start_idx = (u32)(start_frame - queue_oldest_frame);
+    const u32 input_end_idx = input_start_idx + count;
+
+    oldest->spectator = spectator;
+    oldest->start_frame = start_frame;
+    oldest->count = count;
+    oldest->last_used = _encode_clock;
+
+    // the evicted packet is rebuilt in place so its buffer gets reused.
+    InputMsg& msg = oldest->msg;
+    msg.start_frame = start_frame;
+    msg.inputs.clear();
+
+    if (spectator) {
+        for (u32 i = input_start_idx; i < input_end_idx; i++) {
+            const u8* p_input = queue.inputs.at(i);
+            msg.inputs.insert(msg.inputs.end(),
+                p_input,
+                p_input + _input_size * num_players);
+        }
+    }
+    else {
+        for (u32 player = 0; player < num_players; player++) {
+            const auto& player_queue = _net_player_queue[locals[player]->handle];
             for (u32 i = input_start_idx; i < input_end_idx; i++) {
-                const auto& p_input = queue.inputs.at(i);
+                const u8* p_input = player_queue.inputs.at(i);
                 msg.inputs.insert(msg.inputs.end(),
-                    p_input.get(),
-                    p_input.get() + _input_size * num_players);
+                    p_input,
+                    p_input + _input_size);
             }
         }
-        else {
-            for (u32 player = 0; player < num_players; player++) {
-                const auto& player_queue = _net_player_queue[locals[player]->handle];
-                for (u32 i = input_start_idx; i < input_end_idx; i++) {
-                    const auto& p_input = player_queue.inputs.at(i);
-                    msg.inputs.insert(msg.inputs.end(),
-                        p_input.get(),
-                        p_input.get() + _input_size);
-                }
-            }
-        }
-
-        // RLE compress only when it actually reduces size
-        msg.compressed = false;
-        auto compressed = Compression::RLEEncode(msg.inputs.data(), (u32)msg.inputs.size());
-        if (compressed.size() < msg.inputs.size()) {
-            msg.inputs = std::move(compressed);
-            msg.compressed = true;
-        }
-
-        msg.total_size = (u16)msg.inputs.size();
-        msg.input_count = input_count;
-
-        // cache and send
-        peer->input_cache.packets.push_back(msg);
-
-        NetData data;
-        data.addr.Copy(&peer->address);
-        data.pkt.header.type = packet_type;
-        data.pkt.header.magic = peer->session_magic;
-        data.pkt.body = std::move(msg);
+    }
 
-        SendDataTo(&data, host);
+    // RLE compress only when it actually reduces size
+    msg.compressed = false;
+    Compression::RLEEncode(msg.inputs.data(), (u32)msg.inputs.size(), _rle_buffer);
+    if (_rle_buffer.size() < msg.inputs.size()) {
+        msg.inputs.assign(_rle_buffer.begin(), _rle_buffer.end());
+        msg.compressed = true;
     }
 
-    peer->last_input_send_time = TimeSinceEpoch();
+    msg.total_size = (u16)msg.inputs.size();
+    msg.input_count = (u16)count;
 
-    // update cache keys
-    peer->input_cache.last_acked_frame = peer->stats.last_acked_frame;
-    peer->input_cache.last_input_frame = last_input;
+    return msg;
 }
 
 void Gekko::AdvantageHistory::Init()
@@ -1246,6 +1629,8 @@ void Gekko::AdvantageHistory::Init()
     _remote_frame_adv = 0;
 	std::memset(_local, 0, HISTORY_SIZE * sizeof(i8));
 	std::memset(_remote, 0, HISTORY_SIZE * sizeof(i8));
+	_local_arrival = 0.f;
+	_remote_arrival = 0.f;
 }
 
 void Gekko::AdvantageHistory::Update(Frame frame)
@@ -1280,3 +1665,16 @@ void Gekko::AdvantageHistory::SetRemoteAdvantage(i8 adv) {
     _remote_frame_adv = adv;
 }
 
+void Gekko::AdvantageHistory::AddLocalArrival(f32 adv) {
+    _local_arrival += (adv - _local_arrival) * ARRIVAL_SMOOTHING;
+}
+
+void Gekko::AdvantageHistory::AddRemoteArrival(f32 adv) {
+    _remote_arrival += (adv - _remote_arrival) * ARRIVAL_SMOOTHING;
+}
+
+f32 Gekko::AdvantageHistory::GetArrivalAdvantage() {
+    // same as the average, each peer corrects its share of the gap.
+    return (_local_arrival - _remote_arrival) / 2.f;
+}
+
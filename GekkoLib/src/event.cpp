@@ -1,94 +1,157 @@
 #include "event.h"
+#include "timing.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
 
-void Gekko::GameEventBuffer::Init(u32 input_size)
+void Gekko::GameEventBuffer::Init(u32 input_size, u32 max_advance, u32 max_others)
 {
     _input_size = input_size;
     _index_advance = 0;
     _index_others = 0;
+    _reserve_advance = max_advance;
+    _reserve_others = max_others;
+
+    Allocate();
+}
+
+void Gekko::GameEventBuffer::Reserve(u32 max_advance, u32 max_others)
+{
+    // handed out events may still point into the pool, so only grow it on the next reset.
+    _reserve_advance = std::max(max_advance, _reserve_advance);
+    _reserve_others = std::max(max_others, _reserve_others);
+}
+
+void Gekko::GameEventBuffer::Allocate()
+{
+    _max_advance = _reserve_advance;
+    _max_others = _reserve_others;
+
+    const u32 total = _max_advance + _max_others;
+
+    _events = MakeUniqueArray<GekkoGameEvent, MemEvents>(total);
+    _input_memory = MakeUniqueArray<u8, MemEvents>((size_t)_max_advance * _input_size);
+
+    for (u32 i = 0; i < total; i++) {
+        _events[i].type = GekkoEmptyGameEvent;
+    }
+
+    for (u32 i = 0; i < _max_advance; i++) {
+        _events[i].data.adv.input_len = _input_size;
+        _events[i].data.adv.inputs = _input_memory.get() + (size_t)i * _input_size;
+    }
+
+    _overflow_advance.clear();
+    _overflow_others.clear();
+    _overflow_input_memory.clear();
 }
 
 void Gekko::GameEventBuffer::Reset()
 {
+    const u32 used_advance = std::min(_index_advance, _max_advance);
+    const u32 used_others = std::min(_index_others, _max_others);
+
+    // an update needed more events than preallocated, grow the pool to the high water mark.
+    Reserve(_index_advance, _index_others);
+
     _index_advance = 0;
     _index_others = 0;
 
-    // clear the inputs
-    for (auto& ev : _buffer_advance){
-        if (ev->type == GekkoEmptyGameEvent) {
-            break;
-        }
-        // reuse the input buffer rather than destroying it.
-        // set event to empty to be used again.
-        ev->type = GekkoEmptyGameEvent;
+    if (_reserve_advance > _max_advance || _reserve_others > _max_others) {
+        Allocate();
+        return;
     }
 
-    for (auto& ev : _buffer_others) {
-        if (ev->type == GekkoEmptyGameEvent) {
-            break;
-        }
-        // set event to empty to be used again.
-        ev->type = GekkoEmptyGameEvent;
+    // set the used events to empty to be used again.
+    // the advance events keep their input memory.
+    for (u32 i = 0; i < used_advance; i++) {
+        _events[i].type = GekkoEmptyGameEvent;
+    }
+
+    for (u32 i = 0; i < used_others; i++) {
+        _events[_max_advance + i].type = GekkoEmptyGameEvent;
     }
 }
 
 GekkoGameEvent* Gekko::GameEventBuffer::GetEvent(bool advance)
 {
-    auto& buff = advance ? _buffer_advance : _buffer_others;
-    u16& idx = advance ? _index_advance : _index_others;
+    u32& idx = advance ? _index_advance : _index_others;
+    const u32 max = advance ? _max_advance : _max_others;
 
     idx++;
 
-    if (buff.size() < idx) {
-        buff.push_back(std::make_unique<GekkoGameEvent>());
+    if (idx <= max) {
+        return &_events[(advance ? 0 : _max_advance) + idx - 1];
+    }
+
+    auto& overflow = advance ? _overflow_advance : _overflow_others;
+    const u32 overflow_idx = idx - max;
+
+    if (overflow.size() < overflow_idx) {
+        overflow.push_back(MakeUnique<GekkoGameEvent, MemEvents>());
 
         if (advance) {
-            buff.back()->data.adv.input_len = _input_size;
-            // add more input space when needed
-            if (_input_memory_buffer.size() < idx) {
-                _input_memory_buffer.push_back(std::make_unique<u8[]>(_input_size));
-            }
-            buff.back()->data.adv.inputs = _input_memory_buffer.back().get();
+            _overflow_input_memory.push_back(MakeUniqueArray<u8, MemEvents>(_input_size));
+            overflow.back()->data.adv.input_len = _input_size;
+            overflow.back()->data.adv.inputs = _overflow_input_memory.back().get();
         }
     }
 
-    assert(idx != 0);
-
-    return buff[idx - 1].get();
+    return overflow[overflow_idx - 1].get();
 }
 
-Gekko::SessionEventBuffer::SessionEventBuffer()
+void Gekko::SessionEventBuffer::Init(u32 max_events)
 {
     _index = 0;
+    _max_events = max_events;
+    _events = MakeUniqueArray<GekkoSessionEvent, MemEvents>(_max_events);
+
+    for (u32 i = 0; i < _max_events; i++) {
+        _events[i].type = GekkoEmptySessionEvent;
+    }
+
+    _overflow.clear();
 }
 
 GekkoSessionEvent* Gekko::SessionEventBuffer::GetEvent()
 {
     _index++;
 
-    if(_buffer.size() < _index) {
-        _buffer.push_back(std::make_unique<GekkoSessionEvent>());
+    if (_index <= _max_events) {
+        return &_events[_index - 1];
     }
 
-    assert(_index != 0);
+    const u32 overflow_idx = _index - _max_events;
+
+    if (_overflow.size() < overflow_idx) {
+        _overflow.push_back(MakeUnique<GekkoSessionEvent, MemEvents>());
+    }
 
-    return _buffer[_index - 1].get();
+    return _overflow[overflow_idx - 1].get();
 }
 
 void Gekko::SessionEventBuffer::Reset()
 {
-    _index = 0;
-
-    for (auto& ev : _buffer) {
-        if (ev->type == GekkoEmptySessionEvent) {
-            break;
-        }
+    // a burst needed more events than preallocated, grow the pool to the high water mark.
+    if (_index > _max_events) {
+        Init(_index);
+        return;
+    }
 
-        ev->type = GekkoEmptySessionEvent;
+    for (u32 i = 0; i < _index; i++) {
+        _events[i].type = GekkoEmptySessionEvent;
     }
+
+    _index = 0;
+}
+
+void Gekko::SessionEventSystem::Init(u32 max_events)
+{
+    _event_buffer.Init(max_events);
+    _events.clear();
+    _events.reserve(max_events);
 }
 
 void Gekko::SessionEventSystem::Reset()
@@ -102,7 +165,7 @@ void Gekko::SessionEventSystem::AddEvent(GekkoSessionEvent* ev)
     _events.push_back(ev);
 }
 
-std::vector<GekkoSessionEvent*>& Gekko::SessionEventSystem::GetRecentEvents()
+Gekko::Vector<GekkoSessionEvent*, Gekko::MemEvents>& Gekko::SessionEventSystem::GetRecentEvents()
 {
     return _events;
 }
@@ -165,32 +228,47 @@ void Gekko::SessionEventSystem::AddDesyncDetectedEvent(Frame frame, Handle remot
     AddEvent(ev);
 }
 
-void Gekko::GameEventSystem::Init(u32 input_size) {
-    _event_buffer.Init(input_size);
-    _event_buffer.Reset();
+void Gekko::GameEventSystem::Init(u32 input_size, u32 max_advance, u32 max_others) {
+    _input_size = input_size;
+
+    _event_buffer.Init(input_size, max_advance, max_others);
     _current_events.clear();
+    _current_events.reserve(max_advance + max_others);
 }
 
-bool Gekko::GameEventSystem::AddAdvanceEvent(SyncSystem& sync, bool rolling_back, bool running_ahead)
+void Gekko::GameEventSystem::Reserve(u32 max_advance, u32 max_others)
+{
+    _event_buffer.Reserve(max_advance, max_others);
+    _current_events.reserve(max_advance + max_others);
+}
+
+bool Gekko::GameEventSystem::AddAdvanceEvent(SyncSystem& sync, bool rolling_back, bool running_ahead, bool fast_forward)
 {
     Frame frame = GameInput::NULL_FRAME;
-    std::unique_ptr<u8[]> inputs;
+    u8* inputs = nullptr;
     if (!sync.GetCurrentInputs(inputs, frame)) {
         return false;
     }
 
-    _current_events.push_back(_event_buffer.GetEvent(true));
-
-    auto event = _current_events.back();
+    auto event = NextEvent(true);
+    _num_advances++;
 
     event->type = GekkoAdvanceEvent;
     event->data.adv.frame = frame;
     event->data.adv.rolling_back = rolling_back;
     event->data.adv.running_ahead = running_ahead;
+    event->data.adv.fast_forward = fast_forward;
 
-    if (event->data.adv.inputs) {
-        std::memcpy(event->data.adv.inputs, inputs.get(), event->data.adv.input_len);
+    if (_use_callbacks) {
+        // the callback is done with the inputs before the sync system reuses them.
+        event->data.adv.input_len = _input_size;
+        event->data.adv.inputs = inputs;
     }
+    else if (event->data.adv.inputs) {
+        std::memcpy(event->data.adv.inputs, inputs, event->data.adv.input_len);
+    }
+
+    Dispatch(event);
 
     return true;
 }
@@ -201,10 +279,9 @@ void Gekko::GameEventSystem::AddSaveEvent(SyncSystem& sync, StateStorage& storag
 
     auto state = storage.GetState(frame_to_save);
     state->frame = frame_to_save;
+    state->valid = true;
 
-    _current_events.push_back(_event_buffer.GetEvent(false));
-
-    auto event = _current_events.back();
+    auto event = NextEvent(false);
     event->type = GekkoSaveEvent;
 
     event->data.save.frame = frame_to_save;
@@ -212,6 +289,8 @@ void Gekko::GameEventSystem::AddSaveEvent(SyncSystem& sync, StateStorage& storag
     event->data.save.checksum = &state->checksum;
     event->data.save.state_len = &state->state_len;
 
+    Dispatch(event);
+
     if (last_saved_frame) {
         *last_saved_frame = frame_to_save;
     }
@@ -219,53 +298,138 @@ void Gekko::GameEventSystem::AddSaveEvent(SyncSystem& sync, StateStorage& storag
 
 void Gekko::GameEventSystem::AddLoadEvent(SyncSystem& sync, StateStorage& storage)
 {
-    const Frame frame_to_load = sync.GetCurrentFrame();
+    AddLoadEvent(storage, sync.GetCurrentFrame());
+}
 
-    auto state = storage.GetState(frame_to_load);
+void Gekko::GameEventSystem::AddLoadEvent(StateStorage& storage, Frame frame)
+{
+    const Frame frame_to_load = frame;
 
-    _current_events.push_back(_event_buffer.GetEvent(false));
+    auto state = storage.GetState(frame_to_load);
+    // a rollback can only go back to a state thats still in the ring.
+    assert(state->valid && state->frame == frame_to_load);
 
-    auto event = _current_events.back();
+    auto event = NextEvent(false);
     event->type = GekkoLoadEvent;
 
     event->data.load.frame = frame_to_load;
     event->data.load.state = state->state.get();
     event->data.load.state_len = state->state_len;
+
+    Dispatch(event);
 }
 
-void Gekko::GameEventSystem::AddRunaheadSaveEvent(SyncSystem& sync, StateStorage& storage)
+void Gekko::GameEventSystem::AddRunaheadSaveEvent(SyncSystem& sync, StateStorage& storage, Frame frame)
 {
-    const Frame frame_to_save = sync.GetCurrentFrame();
+    const Frame frame_to_save = frame;
 
-    auto state = storage.GetRunaheadState();
+    auto state = storage.GetRunaheadState(frame_to_save);
     state->frame = frame_to_save;
+    state->valid = true;
 
-    _current_events.push_back(_event_buffer.GetEvent(false));
+    // the inputs let the next update tell whether the frame still holds.
+    u8* inputs = nullptr;
+    if (state->inputs && sync.GetFrameInputs(inputs, frame_to_save)) {
+        std::memcpy(state->inputs.get(), inputs, _input_size);
+    }
 
-    auto event = _current_events.back();
+    auto event = NextEvent(false);
     event->type = GekkoSaveEvent;
 
     event->data.save.frame = frame_to_save;
     event->data.save.state = state->state.get();
     event->data.save.checksum = &state->checksum;
     event->data.save.state_len = &state->state_len;
+
+    Dispatch(event);
 }
 
-void Gekko::GameEventSystem::AddRunaheadLoadEvent(StateStorage& storage)
+void Gekko::GameEventSystem::AddRunaheadLoadEvent(StateStorage& storage, Frame frame)
 {
-    auto state = storage.GetRunaheadState();
+    auto state = storage.GetRunaheadState(frame);
 
-    _current_events.push_back(_event_buffer.GetEvent(false));
-
-    auto event = _current_events.back();
+    auto event = NextEvent(false);
     event->type = GekkoLoadEvent;
 
     event->data.load.frame = state->frame;
     event->data.load.state = state->state.get();
     event->data.load.state_len = state->state_len;
+
+    Dispatch(event);
+}
+
+void Gekko::GameEventSystem::SetCallbacks(GekkoSimCallbacks* callbacks)
+{
+    _use_callbacks = callbacks != nullptr;
+    _callbacks = callbacks ? *callbacks : GekkoSimCallbacks();
+}
+
+bool Gekko::GameEventSystem::UsesCallbacks() const
+{
+    return _use_callbacks;
+}
+
+void Gekko::GameEventSystem::SetInstance(GekkoSimInstance instance)
+{
+    _instance = instance;
+}
+
+u32 Gekko::GameEventSystem::GetAdvanceCount() const
+{
+    return _num_advances;
+}
+
+u32 Gekko::GameEventSystem::GetSimTime() const
+{
+    return (u32)_sim_time_us;
+}
+
+GekkoGameEvent* Gekko::GameEventSystem::NextEvent(bool advance)
+{
+    if (_use_callbacks) {
+        // the callbacks consume the event right away so theres nothing to buffer.
+        _callback_event = GekkoGameEvent();
+        _callback_event.instance = _instance;
+        return &_callback_event;
+    }
+
+    _current_events.push_back(_event_buffer.GetEvent(advance));
+    _current_events.back()->instance = _instance;
+    return _current_events.back();
+}
+
+void Gekko::GameEventSystem::Dispatch(GekkoGameEvent* ev)
+{
+    if (!_use_callbacks) {
+        return;
+    }
+
+    const u64 start = TimeSync::Now();
+
+    switch (ev->type) {
+    case GekkoAdvanceEvent:
+        if (_callbacks.advance) {
+            _callbacks.advance(_callbacks.user_data, ev);
+        }
+        break;
+    case GekkoSaveEvent:
+        if (_callbacks.save) {
+            _callbacks.save(_callbacks.user_data, ev);
+        }
+        break;
+    case GekkoLoadEvent:
+        if (_callbacks.load) {
+            _callbacks.load(_callbacks.user_data, ev);
+        }
+        break;
+    default:
+        break;
+    }
+
+    _sim_time_us += TimeSync::Now() - start;
 }
 
-std::vector<GekkoGameEvent*>& Gekko::GameEventSystem::GetEvents()
+Gekko::Vector<GekkoGameEvent*, Gekko::MemEvents>& Gekko::GameEventSystem::GetEvents()
 {
     return _current_events;
 }
@@ -273,6 +437,8 @@ std::vector<GekkoGameEvent*>& Gekko::GameEventSystem::GetEvents()
 void Gekko::GameEventSystem::Reset()
 {
     _event_buffer.Reset();
+    _num_advances = 0;
+    _sim_time_us = 0;
 }
 
 void Gekko::GameEventSystem::Clear()
@@ -11,7 +11,19 @@ Gekko::GameSession::GameSession()
     _disconnected_input = nullptr;
     _last_sent_healthcheck = GameInput::NULL_FRAME;
     _runahead_start_frame = GameInput::NULL_FRAME;
+    _runahead_end_frame = GameInput::NULL_FRAME;
+    _runahead_continued = false;
+    _runahead_instance = false;
+    _runahead_on_instance = false;
+    _runahead_instance_stale = true;
     _runahead_frames = 0;
+    _rollback_budget = 0;
+    _catch_up_frames = 0;
+    _resim_frame = GameInput::NULL_FRAME;
+    _target_window = 0;
+    _reported_sim_time = 0;
+    _sim_time_reported = false;
+    _last_advance_count = 0;
     _config = GekkoConfig();
 }
 
@@ -24,20 +36,29 @@ void Gekko::GameSession::Init(GekkoConfig* config)
     // get given configs
     std::memcpy(&_config, config, sizeof(GekkoConfig));
 
-    // setup input buffer for the players
-    _sync.Init(_config.num_players, _config.input_size);
+    // setup input buffer for the players, the network queue references local inputs in place
+    // so keep them around for longer than the queue holds on to them.
+    _sync.Init(_config.num_players, _config.input_size, InputBuffer::DEFAULT_BUFF_SIZE + MessageSystem::MAX_INPUT_QUEUE_SIZE);
 
     // setup message system.
     _msg.Init(_config.num_players, _config.input_size);
 
     // setup game event system
-    _game_events.Init(_config.input_size * _config.num_players);
+    _game_events.Init(_config.input_size * _config.num_players, MaxAdvanceEvents(), MaxOtherEvents());
+
+    // setup session event system
+    _msg.session_events.Init(((u32)_config.num_players + _config.max_spectators) * SessionEventSystem::EVENTS_PER_ACTOR);
 
     // setup state storage
     _storage.Init(_config.input_prediction_window, _config.state_size, _config.limited_saving);
+    _target_window = _config.input_prediction_window;
+    ReserveRunahead();
+
+    // setup frame pacing
+    _time_sync.Init();
 
     // setup disconnected input for disconnected player within the session
-    _disconnected_input = std::make_unique<u8[]>(_config.input_size);
+    _disconnected_input = MakeUniqueArray<u8, MemInput>(_config.input_size);
     std::memset(_disconnected_input.get(), 0, _config.input_size);
 
     // we only detect desyncs whenever we are not limited saving for now.
@@ -47,6 +68,74 @@ void Gekko::GameSession::Init(GekkoConfig* config)
 void Gekko::GameSession::SetRunahead(u8 runahead)
 {
     _runahead_frames = runahead;
+    _game_events.Reserve(MaxAdvanceEvents(), MaxOtherEvents());
+    ReserveRunahead();
+}
+
+void Gekko::GameSession::SetRunaheadInstance(bool enabled)
+{
+    // the instance is brought up to date from the saves of the primary one.
+    _runahead_instance = enabled && !_config.limited_saving;
+}
+
+void Gekko::GameSession::SetAdaptiveRunahead(GekkoAdaptiveRunahead* settings)
+{
+    if (!settings) {
+        _runahead_control.Disable();
+        return;
+    }
+
+    _runahead_control.Init(settings);
+    _sim_time_reported = false;
+
+    // reserve for the deepest runahead up front so changing it doesnt allocate.
+    _game_events.Reserve(MaxAdvanceEvents(), MaxOtherEvents());
+    ReserveRunahead();
+}
+
+void Gekko::GameSession::ReportSimTime(u32 time_us)
+{
+    _reported_sim_time = time_us;
+    _sim_time_reported = true;
+}
+
+void Gekko::GameSession::SetCatchUp(u8 max_frames)
+{
+    _catch_up_frames = max_frames;
+    _game_events.Reserve(MaxAdvanceEvents(), MaxOtherEvents());
+}
+
+void Gekko::GameSession::SetRollbackBudget(u8 frames)
+{
+    // the gap to the present only closes when more than one frame gets resimulated per update.
+    _rollback_budget = frames < 2 ? 0 : frames;
+}
+
+void Gekko::GameSession::SetPredictionWindow(u8 window)
+{
+    // switching between lockstep and rollback isnt supported, neither is changing it before the start.
+    if (_config.num_players == 0 || IsLockstepActive() || window == 0) {
+        return;
+    }
+
+    _target_window = window;
+
+    // stop predicting past the new window right away, the storage follows once it isnt needed anymore.
+    for (auto& remote : _msg.remotes) {
+        _sync.SetInputPredictionWindow(remote->handle, std::min(window, _config.input_prediction_window));
+    }
+
+    ApplyPredictionWindow();
+}
+
+void Gekko::GameSession::SetAdaptivePredictionWindow(GekkoAdaptivePredictionWindow* settings)
+{
+    if (!settings || IsLockstepActive()) {
+        _window_control.Disable();
+        return;
+    }
+
+    _window_control.Init(settings);
 }
 
 void Gekko::GameSession::SetLocalDelay(i32 player, u8 delay)
@@ -58,6 +147,16 @@ void Gekko::GameSession::SetLocalDelay(i32 player, u8 delay)
     }
 }
 
+void Gekko::GameSession::SetAdaptiveDelay(GekkoAdaptiveDelay* settings)
+{
+    if (!settings) {
+        _delay_control.Disable();
+        return;
+    }
+
+    _delay_control.Init(settings);
+}
+
 void Gekko::GameSession::SetNetAdapter(GekkoNetAdapter* adapter)
 {
     _host = adapter;
@@ -66,10 +165,10 @@ void Gekko::GameSession::SetNetAdapter(GekkoNetAdapter* adapter)
 i32 Gekko::GameSession::AddActor(GekkoPlayerType type, GekkoNetAddress* addr)
 {
     const i32 ERR = -1;
-    std::unique_ptr<NetAddress> address;
+    UniquePtr<NetAddress> address;
 
     if (addr) {
-        address = std::make_unique<NetAddress>(addr->data, addr->size);
+        address = MakeUnique<NetAddress, MemNetwork>(addr->data, addr->size);
     }
 
     if (type == GekkoSpectator) {
@@ -78,7 +177,7 @@ i32 Gekko::GameSession::AddActor(GekkoPlayerType type, GekkoNetAddress* addr)
         }
 
         u32 new_handle = _config.num_players + (u32)_msg.spectators.size();
-        _msg.spectators.push_back(std::make_unique<Player>(new_handle, type, address.get()));
+        _msg.AddActor(new_handle, type, address.get());
 
         return new_handle;
     }
@@ -90,7 +189,7 @@ i32 Gekko::GameSession::AddActor(GekkoPlayerType type, GekkoNetAddress* addr)
         u32 new_handle = (u32)(_msg.locals.size() + _msg.remotes.size());
 
         if (type == GekkoLocalPlayer) {
-            _msg.locals.push_back(std::make_unique<Player>(new_handle, type, address.get()));
+            _msg.AddActor(new_handle, type, address.get());
         }
         else {
             // require an address when specifing a remote player
@@ -98,7 +197,7 @@ i32 Gekko::GameSession::AddActor(GekkoPlayerType type, GekkoNetAddress* addr)
                 return ERR;
             }
 
-            _msg.remotes.push_back(std::make_unique<Player>(new_handle, type, address.get()));
+            _msg.AddActor(new_handle, type, address.get());
             _sync.SetInputPredictionWindow(new_handle, _config.input_prediction_window);
         }
 
@@ -138,6 +237,24 @@ void Gekko::GameSession::AddLocalInput(i32 player, void* input)
     }
 }
 
+void* Gekko::GameSession::AcquireLocalInput(i32 player)
+{
+    for (u32 i = 0; i < _msg.locals.size(); i++) {
+        if (_msg.locals[i]->handle == player) {
+            return _sync.AcquireLocalInput(player);
+        }
+    }
+
+    return nullptr;
+}
+
+void Gekko::GameSession::CommitLocalInputs()
+{
+    for (auto& local : _msg.locals) {
+        _sync.CommitLocalInput(local->handle);
+    }
+}
+
 GekkoGameEvent** Gekko::GameSession::UpdateSession(i32* count)
 {
     // reset session events
@@ -149,8 +266,16 @@ GekkoGameEvent** Gekko::GameSession::UpdateSession(i32* count)
     // clear GameEvents
     _game_events.Clear();
 
-    // gameplay
-    if (AllActorsValid()) {
+    // gameplay, checking the actors also proposes the start so it only happens once per update.
+    const bool actors_valid = AllActorsValid();
+
+    if (actors_valid && IsPlayingLocally()) {
+        UpdateLocalSession();
+    }
+    else if (actors_valid) {
+        // the interval between updates is the frame time the pacing works with.
+        _time_sync.OnUpdate(TimeSync::Now());
+
         // reset the game event buffer before doing anything else
         _game_events.Reset();
 
@@ -172,22 +297,86 @@ GekkoGameEvent** Gekko::GameSession::UpdateSession(i32* count)
         // check if the session is still doing alright.
         SessionIntegrityCheck();
 
-        // then advance the session
-        if (!ShouldStallAdvance() && _game_events.AddAdvanceEvent(_sync, false, _runahead_frames > 0)) {
+        // catch up on frames when lagging behind the peers
+        HandleCatchUp();
+
+        // then advance the session, the runahead might have simulated this frame with the same inputs already.
+        if (_runahead_continued) {
+            AdoptRunaheadFrame();
+        }
+        else if (IsLockstepActive()) {
+            HandleLockstepAdvance();
+        }
+        else if (!ShouldStallAdvance() && _game_events.AddAdvanceEvent(_sync, false, _runahead_frames > 0)) {
             if (!_config.limited_saving) {
                 _game_events.AddSaveEvent(_sync, _storage, &_last_saved_frame);
             }
             _sync.IncrementFrame();
         }
+        else if (IsPredictionExhausted()) {
+            _window_control.AddStall();
+        }
+
+        // simulate the alternatives of the predicted inputs in the background
+        HandleSpeculation();
 
         // run ahead if configured
         HandleRunahead();
+
+        // adjust the pacing towards the peers
+        UpdateTimeSync();
+
+        // adjust the local delay and runahead to the measured conditions
+        AdaptToConditions();
     }
 
     *count = _game_events.Count();
     return _game_events.Data();
 }
 
+void Gekko::GameSession::UpdateLocalSession()
+{
+    _time_sync.OnUpdate(TimeSync::Now());
+
+    _game_events.Reset();
+
+    // the second runahead instance starts over from the saved states.
+    SaveInitialState();
+
+    RewindRunahead();
+
+    // nothing is predicted or rolled back, the local inputs go straight into the advance.
+    if (_runahead_continued) {
+        AdoptRunaheadFrame();
+    }
+    else if (_game_events.AddAdvanceEvent(_sync, false, _runahead_frames > 0)) {
+        if (IsSavingStates() && !_config.limited_saving) {
+            _game_events.AddSaveEvent(_sync, _storage, &_last_saved_frame);
+        }
+        _sync.IncrementFrame();
+    }
+
+    HandleRunahead();
+
+    AdaptRunahead(0, 0);
+}
+
+void Gekko::GameSession::SetSimCallbacks(GekkoSimCallbacks* callbacks)
+{
+    _game_events.SetCallbacks(callbacks);
+}
+
+void Gekko::GameSession::SetSpeculation(GekkoSpeculationCallbacks* callbacks, u8 num_branches)
+{
+    // branches are adopted into the state storage, so every frame has to be saved.
+    if (!callbacks || num_branches == 0 || IsLockstepActive() || _config.limited_saving) {
+        _speculation.Stop();
+        return;
+    }
+
+    _speculation.Init(callbacks, num_branches, _config.input_size * _config.num_players, _config.state_size);
+}
+
 GekkoSessionEvent** Gekko::GameSession::Events(i32* count)
 {
     *count = (i32)_msg.session_events.GetRecentEvents().size();
@@ -211,9 +400,29 @@ f32 Gekko::GameSession::FramesAhead()
     return count > 0 ? sum / (f32)count : 0.f;
 }
 
+i32 Gekko::GameSession::StartTime()
+{
+    if (_started) {
+        return 0;
+    }
+
+    const u64 start = _msg.GetStartTime();
+    if (start == 0) {
+        return -1;
+    }
+
+    const u64 now = TimeSync::Now();
+    return start > now ? (i32)(start - now) : 0;
+}
+
+void Gekko::GameSession::TimingAdvice(GekkoTimingAdvice* advice)
+{
+    _time_sync.GetAdvice(TimeSync::Now(), advice);
+}
+
 void Gekko::GameSession::NetworkStats(i32 player, GekkoNetworkStats* stats)
 {
-    std::vector<std::unique_ptr<Player>>* current = &_msg.remotes;
+    Vector<UniquePtr<Player>>* current = &_msg.remotes;
 
     for (u32 i = 0; i < 2; i++)
     {
@@ -287,6 +496,11 @@ void Gekko::GameSession::SendSessionHealthCheck()
         return;
     }
 
+    // the save still holds the old prediction until the budgeted rollback caught up.
+    if (_resim_frame != GameInput::NULL_FRAME && confirmed >= _resim_frame) {
+        return;
+    }
+
     auto sav = _storage.GetState(confirmed);
 
     assert(sav->frame == confirmed);
@@ -364,7 +578,7 @@ void Gekko::GameSession::AddDisconnectedPlayerInputs()
             const Frame raised_up_to = std::min(disc_frame, received);
             for (Frame frame = player->applied_disconnect_frame + 1; frame <= raised_up_to; frame++) {
                 if (frame >= oldest && frame <= last_added) {
-                    _sync.OverwriteInput(handle, input_q[frame - oldest].get(), frame);
+                    _sync.OverwriteInput(handle, input_q[frame - oldest], frame);
                 }
             }
         }
@@ -376,7 +590,7 @@ void Gekko::GameSession::AddDisconnectedPlayerInputs()
 
         for (Frame frame = last_recv; frame <= current; frame++) {
             if (frame <= disc_frame && frame >= oldest && frame <= last_added) {
-                _sync.AddRemoteInput(handle, input_q[frame - oldest].get(), frame);
+                _sync.AddRemoteInput(handle, input_q[frame - oldest], frame);
             }
             else {
                 _sync.AddRemoteInput(handle, _disconnected_input.get(), frame);
@@ -390,42 +604,66 @@ void Gekko::GameSession::SendSpectatorInputs()
     const Frame current = _msg.GetLastAddedInput(true) + 1;
     const Frame confirmed = GetConfirmedFrame();
 
-    std::unique_ptr<u8[]> inputs;
+    u8* inputs = nullptr;
     for (Frame frame = current; frame <= confirmed; frame++) {
         if (!_sync.GetSpectatorInputs(inputs, frame)) {
             break;
         }
-        _msg.AddSpectatorInput(frame, inputs.get());
+        _msg.AddSpectatorInput(frame, inputs);
     }
 }
 
-void Gekko::GameSession::HandleRollback()
+void Gekko::GameSession::SaveInitialState()
 {
-    Frame current = _sync.GetCurrentFrame();
-    if (_last_saved_frame == GameInput::NULL_FRAME - 1) {
-        _sync.SetCurrentFrame(current - 1);
-        _game_events.AddSaveEvent(_sync, _storage, &_last_saved_frame);
-        _sync.IncrementFrame();
+    if (_last_saved_frame != GameInput::NULL_FRAME - 1 || !IsSavingStates()) {
+        return;
     }
 
-    if (!RollbackPending()) {
+    const Frame current = _sync.GetCurrentFrame();
+    _sync.SetCurrentFrame(current - 1);
+    _game_events.AddSaveEvent(_sync, _storage, &_last_saved_frame);
+    _sync.IncrementFrame();
+}
+
+void Gekko::GameSession::HandleRollback()
+{
+    SaveInitialState();
+
+    if (!RollbackPending() && _resim_frame == GameInput::NULL_FRAME) {
         return;
     }
 
-    current = _sync.GetCurrentFrame();
-    const Frame min = _sync.GetMinIncorrectFrame();
+    const Frame current = _sync.GetCurrentFrame();
+    const Frame min = GetRollbackStartFrame();
+
+    _delay_control.AddRollback(current - min);
 
-    const Frame sync_frame = _config.limited_saving ? _last_saved_frame : min - 1;
+    Frame sync_frame = _config.limited_saving ? _last_saved_frame : min - 1;
     // never keep a save beyond the confirmed frame, a disconnect claim may
     // still change inputs past it and the save would bake in the wrong ones.
     const Frame frame_to_save = std::min(std::min(current - 1, min), GetConfirmedFrame());
 
+    // a branch which already simulated the mispredicted frame with the right inputs saves resimulating it.
+    if (AdoptSpeculation(min)) {
+        sync_frame = min;
+    }
+
+    // with a budget only the oldest frames get resimulated now, the rest follows in the next updates.
+    const u8 budget = GetRollbackBudget();
+    Frame resim_end = current;
+    _resim_frame = GameInput::NULL_FRAME;
+
+    if (budget > 0 && current - (sync_frame + 1) > budget) {
+        resim_end = sync_frame + 1 + budget;
+        _resim_frame = resim_end;
+    }
+
     // load the sync frame
     _sync.SetCurrentFrame(sync_frame);
     _game_events.AddLoadEvent(_sync, _storage);
     _sync.IncrementFrame();
 
-    for (Frame frame = sync_frame + 1; frame < current; frame++) {
+    for (Frame frame = sync_frame + 1; frame < resim_end; frame++) {
         _game_events.AddAdvanceEvent(_sync, true);
         if (!_config.limited_saving || frame == frame_to_save) {
             _game_events.AddSaveEvent(_sync, _storage, &_last_saved_frame);
@@ -436,6 +674,14 @@ void Gekko::GameSession::HandleRollback()
     // clear the marked mispredictions up to this point in the input buffer
     _sync.ClearIncorrectFramesUpTo(current);
 
+    if (_resim_frame != GameInput::NULL_FRAME) {
+        // keep going from the state on display, the saves after the resimulated
+        // frames are off until the rollback catches up with the present.
+        _sync.SetCurrentFrame(current - 1);
+        _game_events.AddLoadEvent(_sync, _storage);
+        _sync.SetCurrentFrame(current);
+    }
+
     // make sure that we are back where we started.
     assert(_sync.GetCurrentFrame() == current);
 }
@@ -477,11 +723,19 @@ bool Gekko::GameSession::AllActorsValid()
             return false;
         }
 
+        // hold frame 0 back until the start the peers agreed on, so they all begin together.
+        const u64 start = _msg.GetStartTime();
+        if (start == 0 || TimeSync::Now() < start) {
+            return false;
+        }
+
         // if none returned that the session is ready!
         _msg.session_events.AddSessionStartedEvent();
 
         _started = true;
 
+        Memory::MarkSteady();
+
         return true;
     }
 
@@ -504,15 +758,22 @@ void Gekko::GameSession::HandleReceivedInputs()
             const Frame min_frame = last_added - (i32)input_q.size() + 1;
             const Frame current_frame = _sync.GetCurrentFrame();
             const Frame local_delay = (Frame)GetMinLocalDelay();
+            const u8 phase = _time_sync.GetFramePhase(TimeSync::Now());
             for (int i = last_recv; i <= last_added; i++) {
                 if (i >= min_frame) {
                     int current_idx = i - min_frame;
-                    u8* input = input_q[current_idx].get();
+                    u8* input = input_q[current_idx];
                     _sync.AddRemoteInput(handle, input, i);
                     const i8 local_adv = (i8)(current_frame - i - local_delay);
-                    _msg.SendInputAck(handle, i, local_adv);
+                    _msg.QueueInputAck(handle, i, local_adv, phase);
                 }
             }
+
+            // the newest input tells how far ahead we are right as it arrived.
+            if (last_added >= last_recv) {
+                const f32 local_adv = (f32)(current_frame - last_added - local_delay) + phase / 256.f;
+                remote->adv_history.AddLocalArrival(local_adv);
+            }
         }
     }
 }
@@ -523,13 +784,13 @@ void Gekko::GameSession::SendLocalInputs()
         const Frame current = _msg.GetLastAddedInput(false) + 1;
         const Frame delay = GetMinLocalDelay();
 
-        auto input = std::make_unique<u8[]>(_config.input_size);
         for (Frame frame = current; frame <= current + delay; frame++) {
             for (auto& player : _msg.locals) {
-                if (!_sync.GetLocalInput(player->handle, input, frame)) {
+                u8* input = _sync.GetLocalInput(player->handle, frame);
+                if (!input) {
                     return;
                 }
-                _msg.AddInput(frame, player->handle, input.get());
+                _msg.AddInput(frame, player->handle, input);
             }
             // Record per-peer advantage snapshot once per actual game frame
             if (frame == current) {
@@ -546,6 +807,150 @@ void Gekko::GameSession::SendLocalInputs()
     }
 }
 
+void Gekko::GameSession::UpdateTimeSync()
+{
+    f32 sum = 0.f;
+    f32 rtt = 0.f;
+    i32 count = 0;
+
+    for (auto& remote : _msg.remotes) {
+        if (remote->GetStatus() == Connected) {
+            sum += remote->adv_history.GetArrivalAdvantage();
+            rtt = std::max(rtt, remote->stats.CalculateAvgRTT());
+            count++;
+        }
+    }
+
+    _time_sync.Update(count > 0 ? sum / (f32)count : 0.f, rtt);
+}
+
+void Gekko::GameSession::AdaptToConditions()
+{
+    u32 hits = 0;
+    u32 misses = 0;
+    _sync.TakePredictionCounts(hits, misses);
+
+    AdaptLocalDelay(hits, misses);
+    AdaptRunahead(hits, misses);
+    AdaptPredictionWindow();
+
+    // a narrower window waits until the session isnt predicting past it anymore.
+    ApplyPredictionWindow();
+}
+
+void Gekko::GameSession::AdaptLocalDelay(u32 hits, u32 misses)
+{
+    if (!_delay_control.IsActive() || IsPlayingLocally() || _msg.locals.empty()) {
+        return;
+    }
+
+    f32 rtt = 0.f;
+    f32 jitter = 0.f;
+    GetNetworkConditions(rtt, jitter);
+
+    const u8 delay = GetMinLocalDelay();
+    const u8 next = _delay_control.Update(delay, hits, misses, rtt, jitter, _time_sync.GetFrameTime() / 1000.f);
+
+    if (next == delay) {
+        return;
+    }
+
+    for (auto& local : _msg.locals) {
+        _sync.SetLocalDelay(local->handle, next);
+    }
+}
+
+void Gekko::GameSession::AdaptRunahead(u32 hits, u32 misses)
+{
+    const u32 advances = _game_events.GetAdvanceCount();
+
+    if (!_runahead_control.IsActive() || (IsLockstepActive() && !IsPlayingLocally())) {
+        _last_advance_count = advances;
+        return;
+    }
+
+    // the callbacks are timed as they run, the game reports the events of the previous update itself.
+    if (_game_events.UsesCallbacks()) {
+        _runahead_control.AddSample(_game_events.GetSimTime(), advances);
+    }
+    else if (_sim_time_reported) {
+        _runahead_control.AddSample(_reported_sim_time, _last_advance_count);
+        _sim_time_reported = false;
+    }
+
+    _last_advance_count = advances;
+    _runahead_frames = _runahead_control.Update(_runahead_frames, hits, misses);
+}
+
+void Gekko::GameSession::AdaptPredictionWindow()
+{
+    if (!_window_control.IsActive() || IsPlayingLocally() || _msg.locals.empty()) {
+        return;
+    }
+
+    f32 rtt = 0.f;
+    f32 jitter = 0.f;
+    GetNetworkConditions(rtt, jitter);
+
+    const u8 next = _window_control.Update(_target_window, GetMinLocalDelay(), rtt, jitter, _time_sync.GetFrameTime() / 1000.f);
+
+    if (next != _target_window) {
+        SetPredictionWindow(next);
+    }
+}
+
+void Gekko::GameSession::ApplyPredictionWindow()
+{
+    const u8 window = _target_window;
+
+    if (window == _config.input_prediction_window) {
+        return;
+    }
+
+    // the states of the current prediction and of a pending rollback have to survive a narrower ring.
+    if (window < _config.input_prediction_window) {
+        if (RollbackPending() || _resim_frame != GameInput::NULL_FRAME) {
+            return;
+        }
+
+        const Frame depth = _sync.GetCurrentFrame() - _sync.GetMinReceivedFrame() - 1;
+        if (!IsPlayingLocally() && depth > (Frame)window) {
+            return;
+        }
+    }
+
+    _storage.Resize(window);
+    _config.input_prediction_window = window;
+
+    for (auto& remote : _msg.remotes) {
+        _sync.SetInputPredictionWindow(remote->handle, window);
+    }
+
+    _game_events.Reserve(MaxAdvanceEvents(), MaxOtherEvents());
+}
+
+bool Gekko::GameSession::IsPredictionExhausted()
+{
+    if (IsLockstepActive() || IsPlayingLocally()) {
+        return false;
+    }
+
+    const Frame predicted = _sync.GetCurrentFrame() - _sync.GetMinReceivedFrame() - 1;
+    return predicted >= (Frame)_config.input_prediction_window;
+}
+
+void Gekko::GameSession::GetNetworkConditions(f32& rtt, f32& jitter)
+{
+    rtt = 0.f;
+    jitter = 0.f;
+    for (auto& remote : _msg.remotes) {
+        if (remote->GetStatus() == Connected) {
+            rtt = std::max(rtt, remote->stats.CalculateAvgRTT());
+            jitter = std::max(jitter, remote->stats.CalculateJitter());
+        }
+    }
+}
+
 u8 Gekko::GameSession::GetMinLocalDelay()
 {
     u8 min = UINT8_MAX;
@@ -560,11 +965,41 @@ bool Gekko::GameSession::IsPlayingLocally()
     return _msg.remotes.empty() && !_msg.locals.empty();
 }
 
+u32 Gekko::GameSession::MaxAdvanceEvents() const
+{
+    // a resimulation of the whole prediction window, the new frame and the runahead frames.
+    // lockstep never resimulates but advances as many frames as there are inputs for.
+    const u32 frames = IsLockstepActive() ? LOCKSTEP_MAX_FRAMES : _config.input_prediction_window;
+    return frames + 3 + _catch_up_frames + std::max(_runahead_frames, _runahead_control.GetMaxRunahead());
+}
+
+u32 Gekko::GameSession::MaxOtherEvents() const
+{
+    // a save per resimulated frame plus the loads and saves around rollbacks, confirmed saving and a save per frame ran ahead.
+    const u32 frames = IsLockstepActive() ? LOCKSTEP_MAX_FRAMES : _config.input_prediction_window;
+    return frames + 8 + _catch_up_frames + std::max(_runahead_frames, _runahead_control.GetMaxRunahead());
+}
+
 bool Gekko::GameSession::IsLockstepActive() const
 {
     return _config.input_prediction_window == 0;
 }
 
+bool Gekko::GameSession::IsSavingStates()
+{
+    // playing locally never rolls back, only the second runahead instance starts over from the saved states.
+    if (IsPlayingLocally()) {
+        return _runahead_instance && _runahead_frames > 0;
+    }
+
+    // lockstep never goes back to an earlier frame, only the checksums need the states.
+    if (IsLockstepActive()) {
+        return _config.desync_detection;
+    }
+
+    return true;
+}
+
 bool Gekko::GameSession::RollbackPending()
 {
     if (IsLockstepActive() || IsPlayingLocally()) {
@@ -574,6 +1009,28 @@ bool Gekko::GameSession::RollbackPending()
     return _sync.GetMinIncorrectFrame() != GameInput::NULL_FRAME;
 }
 
+Frame Gekko::GameSession::GetRollbackStartFrame()
+{
+    const Frame min = _sync.GetMinIncorrectFrame();
+
+    // a budgeted rollback continues where the previous update left off.
+    if (_resim_frame == GameInput::NULL_FRAME) {
+        return min;
+    }
+
+    return min == GameInput::NULL_FRAME ? _resim_frame : std::min(min, _resim_frame);
+}
+
+u8 Gekko::GameSession::GetRollbackBudget() const
+{
+    // the state on display is only saved when every frame is saved, runahead replaces it every update.
+    if (_config.limited_saving || _runahead_frames > 0) {
+        return 0;
+    }
+
+    return _rollback_budget;
+}
+
 bool Gekko::GameSession::ConfirmedSaveDue()
 {
     if (IsLockstepActive() || !_config.limited_saving || IsPlayingLocally()) {
@@ -603,12 +1060,97 @@ bool Gekko::GameSession::ShouldStallAdvance()
     return _sync.GetCurrentFrame() - hold > (Frame)_config.input_prediction_window;
 }
 
+void Gekko::GameSession::HandleCatchUp()
+{
+    // lockstep already advances every frame it has the inputs for.
+    if (_catch_up_frames == 0 || _config.limited_saving || IsLockstepActive() || IsPlayingLocally() || _msg.locals.empty()) {
+        return;
+    }
+
+    if (_runahead_continued || _resim_frame != GameInput::NULL_FRAME || ShouldStallAdvance()) {
+        return;
+    }
+
+    if (FramesAhead() > -CATCH_UP_THRESHOLD) {
+        return;
+    }
+
+    // only frames every remote input is in for, those never have to be rolled back.
+    Frame confirmed = INT32_MAX;
+    for (auto& remote : _msg.remotes) {
+        if (remote->GetStatus() == Connected) {
+            confirmed = std::min(confirmed, _sync.GetLastReceivedFrom(remote->handle));
+        }
+    }
+
+    const Frame current = _sync.GetCurrentFrame();
+
+    // the regular advance afterwards takes the last frame.
+    const Frame frames = std::min((Frame)_catch_up_frames, confirmed - current);
+    if (confirmed == INT32_MAX || frames <= 0) {
+        return;
+    }
+
+    // the game has to have added its input for this update, that one gets repeated for the extra frames.
+    for (auto& local : _msg.locals) {
+        if (_sync.GetLastReceivedFrom(local->handle) < current + _sync.GetLocalDelay(local->handle)) {
+            return;
+        }
+    }
+
+    for (auto& local : _msg.locals) {
+        _sync.RepeatLocalInput(local->handle, current + frames + _sync.GetLocalDelay(local->handle));
+    }
+
+    for (Frame i = 0; i < frames; i++) {
+        if (!_game_events.AddAdvanceEvent(_sync, false, _runahead_frames > 0, true)) {
+            break;
+        }
+        _game_events.AddSaveEvent(_sync, _storage, &_last_saved_frame);
+        _sync.IncrementFrame();
+    }
+}
+
+void Gekko::GameSession::HandleLockstepAdvance()
+{
+    // every frame with all inputs in is final, so advance through as many as there are.
+    const bool save = IsSavingStates() && !_config.limited_saving;
+    u8 frames = 0;
+
+    while (frames < LOCKSTEP_MAX_FRAMES && !ShouldStallAdvance() && _game_events.AddAdvanceEvent(_sync, false, false)) {
+        if (save) {
+            _game_events.AddSaveEvent(_sync, _storage, &_last_saved_frame);
+        }
+        _sync.IncrementFrame();
+        frames++;
+    }
+
+    if (frames <= 1) {
+        return;
+    }
+
+    // the next local input has to follow on the last one, the frames skipped over get empty inputs.
+    const Frame current = _sync.GetCurrentFrame();
+    for (auto& local : _msg.locals) {
+        _sync.PadLocalInput(local->handle, current + _sync.GetLocalDelay(local->handle) - 1);
+    }
+}
+
 void Gekko::GameSession::RewindRunahead()
 {
+    _runahead_continued = false;
+
     if (_runahead_start_frame == GameInput::NULL_FRAME) {
         return;
     }
 
+    // the primary instance never ran ahead, the runahead instance only needs updating after a rollback.
+    if (_runahead_on_instance) {
+        _runahead_instance_stale = _runahead_instance_stale || RollbackPending();
+        return;
+    }
+
+    const Frame start = _runahead_start_frame;
     _runahead_start_frame = GameInput::NULL_FRAME;
 
     // a rollback or confirmed save will load+resim this frame, so dont load twice.
@@ -616,28 +1158,238 @@ void Gekko::GameSession::RewindRunahead()
         return;
     }
 
-    _game_events.AddRunaheadLoadEvent(_storage);
+    // the frames ran ahead stay on display when the next one was simulated with the real inputs.
+    if (CanContinueRunahead(start)) {
+        _runahead_continued = true;
+        return;
+    }
+
+    _game_events.AddRunaheadLoadEvent(_storage, start - 1);
+}
+
+bool Gekko::GameSession::CanContinueRunahead(Frame start)
+{
+    // a changed runahead starts over, switching to the second instance takes the primary one back to the real frame.
+    if (_runahead_instance || _runahead_end_frame - start + 1 != (Frame)_runahead_frames) {
+        return false;
+    }
+
+    if (_sync.GetCurrentFrame() != start || _resim_frame != GameInput::NULL_FRAME || ShouldStallAdvance()) {
+        return false;
+    }
+
+    // fetching the inputs registers the predictions the same way advancing the frame would.
+    u8* inputs = nullptr;
+    if (!_sync.GetFrameInputs(inputs, start)) {
+        return false;
+    }
+
+    auto state = _storage.GetRunaheadState(start);
+    const u32 input_len = _config.input_size * _config.num_players;
+
+    return state->frame == start && std::memcmp(state->inputs.get(), inputs, input_len) == 0;
+}
+
+void Gekko::GameSession::AdoptRunaheadFrame()
+{
+    const Frame frame = _sync.GetCurrentFrame();
+
+    if (!_config.limited_saving && IsSavingStates()) {
+        _storage.AdoptRunaheadState(frame);
+        _last_saved_frame = frame;
+    }
+
+    _sync.IncrementFrame();
+}
+
+void Gekko::GameSession::ReserveRunahead()
+{
+    if (_config.num_players == 0) {
+        return;
+    }
+
+    // the last real frame and every frame ran ahead.
+    const u32 frames = (u32)std::max(_runahead_frames, _runahead_control.GetMaxRunahead()) + 1;
+    _storage.ReserveRunahead(frames, _config.input_size * _config.num_players);
 }
 
 void Gekko::GameSession::HandleRunahead()
 {
     if ((IsLockstepActive() && !IsPlayingLocally()) || _runahead_frames == 0) {
+        _runahead_start_frame = GameInput::NULL_FRAME;
+        _runahead_end_frame = GameInput::NULL_FRAME;
+        _runahead_on_instance = false;
+        return;
+    }
+
+    if (_runahead_instance) {
+        HandleRunaheadInstance();
         return;
     }
 
-    _runahead_start_frame = _sync.GetCurrentFrame();
-    _game_events.AddRunaheadSaveEvent(_sync, _storage);
+    // coming from the second instance theres no chain in the primary one to continue.
+    if (_runahead_on_instance) {
+        _runahead_on_instance = false;
+        _runahead_continued = false;
+    }
+
+    const Frame start = _sync.GetCurrentFrame();
+    const Frame end = start + _runahead_frames - 1;
+    Frame from = start;
 
     _sync.SetRunaheadMode(true);
-    for (u8 i = 0; i < _runahead_frames; i++) {
-        const bool is_display_frame = (i == _runahead_frames - 1);
+
+    if (_runahead_continued) {
+        // keep the frames ran ahead before up to the first one the inputs changed for.
+        const u32 input_len = _config.input_size * _config.num_players;
+        from = _runahead_end_frame + 1;
+
+        for (Frame frame = start; frame <= _runahead_end_frame; frame++) {
+            u8* inputs = nullptr;
+            if (!_sync.GetFrameInputs(inputs, frame) ||
+                std::memcmp(_storage.GetRunaheadState(frame)->inputs.get(), inputs, input_len) != 0) {
+                from = frame;
+                break;
+            }
+        }
+
+        // the game still holds the last frame ran ahead, otherwise go back to where the chain broke.
+        if (from <= _runahead_end_frame) {
+            _game_events.AddRunaheadLoadEvent(_storage, from - 1);
+        }
+    }
+    else {
+        _game_events.AddRunaheadSaveEvent(_sync, _storage, start - 1);
+    }
+
+    _runahead_end_frame = from - 1;
+    _sync.SetCurrentFrame(from);
+
+    for (Frame frame = from; frame <= end; frame++) {
+        const bool is_display_frame = (frame == end);
         if (!_game_events.AddAdvanceEvent(_sync, false, !is_display_frame)) {
             break;
         }
+        _game_events.AddRunaheadSaveEvent(_sync, _storage, frame);
+        _runahead_end_frame = frame;
         _sync.IncrementFrame();
     }
     _sync.SetRunaheadMode(false);
 
     // Reset back to the real frame so AddLocalInput and network logic see the correct frame
-    _sync.SetCurrentFrame(_runahead_start_frame);
+    _runahead_start_frame = start;
+    _sync.SetCurrentFrame(start);
+}
+
+void Gekko::GameSession::HandleRunaheadInstance()
+{
+    const Frame current = _sync.GetCurrentFrame();
+    const Frame end = current + _runahead_frames - 1;
+    const u32 input_len = _config.input_size * _config.num_players;
+
+    // the instance holds the state after the last frame it ran ahead to, which has to cover the real frames.
+    bool intact = _runahead_on_instance && !_runahead_instance_stale &&
+        _runahead_start_frame != GameInput::NULL_FRAME &&
+        _runahead_end_frame >= current - 1 && _runahead_end_frame <= end;
+
+    _sync.SetRunaheadMode(true);
+
+    // frames that turned real since and the ones still ahead have to match what the instance simulated.
+    for (Frame frame = _runahead_start_frame; intact && frame <= _runahead_end_frame; frame++) {
+        u8* inputs = nullptr;
+        intact = _sync.GetFrameInputs(inputs, frame) &&
+            std::memcmp(_storage.GetRunaheadState(frame)->inputs.get(), inputs, input_len) == 0;
+    }
+
+    _game_events.SetInstance(GekkoRunaheadInstance);
+
+    Frame from = _runahead_end_frame + 1;
+    if (!intact) {
+        // copy the last real state over, nothing to copy before the first frame got saved.
+        if (_storage.GetState(current - 1)->frame != current - 1) {
+            _game_events.SetInstance(GekkoPrimaryInstance);
+            _sync.SetRunaheadMode(false);
+            _runahead_start_frame = GameInput::NULL_FRAME;
+            _runahead_on_instance = false;
+            return;
+        }
+
+        _game_events.AddLoadEvent(_storage, current - 1);
+        from = current;
+        _runahead_end_frame = current - 1;
+    }
+
+    _sync.SetCurrentFrame(from);
+
+    for (Frame frame = from; frame <= end; frame++) {
+        const bool is_display_frame = (frame == end);
+        if (!_game_events.AddAdvanceEvent(_sync, false, !is_display_frame)) {
+            break;
+        }
+
+        // remember the inputs so the next update can tell whether the instance still holds.
+        auto entry = _storage.GetRunaheadState(frame);
+        entry->frame = frame;
+        entry->valid = true;
+
+        u8* inputs = nullptr;
+        if (_sync.GetFrameInputs(inputs, frame)) {
+            std::memcpy(entry->inputs.get(), inputs, input_len);
+        }
+
+        _runahead_end_frame = frame;
+        _sync.IncrementFrame();
+    }
+
+    _game_events.SetInstance(GekkoPrimaryInstance);
+    _sync.SetRunaheadMode(false);
+
+    _runahead_start_frame = current;
+    _runahead_on_instance = true;
+    _runahead_instance_stale = false;
+    _sync.SetCurrentFrame(current);
+}
+
+void Gekko::GameSession::HandleSpeculation()
+{
+    // the base state is only written by the time the update returns when the callbacks are used.
+    if (!_speculation.IsActive() || !_game_events.UsesCallbacks() || IsPlayingLocally()) {
+        return;
+    }
+
+    // the saves the branches would start from are outdated during a budgeted rollback.
+    if (_resim_frame != GameInput::NULL_FRAME) {
+        return;
+    }
+
+    // speculate on the first frame that was simulated with predicted inputs, a rollback starts from there.
+    const Frame frame = _sync.GetMinReceivedFrame() + 1;
+
+    if (frame < 1 || frame >= _sync.GetCurrentFrame() || frame == _speculation.GetFrame()) {
+        return;
+    }
+
+    auto base = _storage.GetState(frame - 1);
+
+    u8* predicted = nullptr;
+    if (base->frame != frame - 1 || !_sync.GetFrameInputs(predicted, frame)) {
+        return;
+    }
+
+    _speculation.Launch(frame, predicted, base);
+}
+
+bool Gekko::GameSession::AdoptSpeculation(Frame frame)
+{
+    if (_speculation.GetFrame() == GameInput::NULL_FRAME) {
+        return false;
+    }
+
+    u8* inputs = nullptr;
+    if (!_sync.GetFrameInputs(inputs, frame)) {
+        _speculation.Discard();
+        return false;
+    }
+
+    return _speculation.Adopt(frame, inputs, _storage.GetState(frame));
 }
@@ -2,36 +2,70 @@
 
 #include "session.h"
 
+template<typename T>
+static GekkoSession* CreateSession()
+{
+    void* mem = Gekko::Memory::Alloc(sizeof(T), Gekko::MemSession);
+    return new (mem) T();
+}
+
+// slab memory kept ready for the messages, packets and bookkeeping churning while the session runs.
+static size_t ZeroAllocReserve(GekkoConfig* config)
+{
+    const size_t actors = (size_t)config->num_players + config->max_spectators;
+    const size_t window = (size_t)config->input_prediction_window + 1;
+    return 256 * 1024 + actors * window * config->input_size * 64;
+}
+
 GEKKONET_API bool gekko_create(GekkoSession** session, GekkoSessionType session_type)
+{
+    return gekko_create_with_allocator(session, session_type, nullptr);
+}
+
+bool gekko_create_with_allocator(GekkoSession** session, GekkoSessionType session_type, GekkoAllocator* allocator)
 {
     if (*session) {
         return false;
     }
 
+    if (session_type != GekkoGameSession &&
+        session_type != GekkoStressSession &&
+        session_type != GekkoSpectateSession) {
+        return false;
+    }
+
+    auto ctx = Gekko::Memory::CreateContext(allocator);
+    Gekko::Memory::Scope scope(ctx);
+
     switch (session_type) {
     case GekkoSessionType::GekkoGameSession:
-        *session = new Gekko::GameSession();
+        *session = CreateSession<Gekko::GameSession>();
         break;
 
     case GekkoSessionType::GekkoStressSession:
-        *session = new Gekko::StressSession();
+        *session = CreateSession<Gekko::StressSession>();
         break;
 
     case GekkoSessionType::GekkoSpectateSession:
-        *session = new Gekko::SpectatorSession();
+        *session = CreateSession<Gekko::SpectatorSession>();
         break;
-
-    default:
-        return false;
     }
 
+    (*session)->memory = ctx;
+
     return true;
 }
 
 bool gekko_destroy(GekkoSession** session)
 {
     if (session && *session) {
-        delete *session;
+        auto ctx = (*session)->memory;
+        {
+            Gekko::Memory::Scope scope(ctx);
+            (*session)->~GekkoSession();
+            Gekko::Memory::Free(*session);
+        }
+        Gekko::Memory::DestroyContext(ctx);
         *session = nullptr;
         return true;
     }
@@ -41,69 +75,188 @@ bool gekko_destroy(GekkoSession** session)
 
 void gekko_start(GekkoSession* session, GekkoConfig* config)
 {
+    Gekko::Memory::Scope scope(session->memory);
+
+    if (config->zero_alloc) {
+        Gekko::Memory::EnablePooling(session->memory, config->lock_memory);
+        Gekko::Memory::Prefault(session);
+    }
+
     session->Init(config);
+
+    if (config->zero_alloc) {
+        Gekko::Memory::Reserve(session->memory, ZeroAllocReserve(config));
+    }
 }
 
 void gekko_net_adapter_set(GekkoSession* session, GekkoNetAdapter* adapter)
 {
+    Gekko::Memory::Scope scope(session->memory);
     session->SetNetAdapter(adapter);
 }
 
 int gekko_add_actor(GekkoSession* session, GekkoPlayerType player_type, GekkoNetAddress* addr)
 {
+    Gekko::Memory::Scope scope(session->memory);
     return session->AddActor(player_type, !addr ? nullptr : addr);
 }
 
 bool gekko_disconnect_actor(GekkoSession* session, int actor)
 {
+    Gekko::Memory::Scope scope(session->memory);
     return session->DisconnectActor(actor);
 }
 
 void gekko_set_disconnect_timeout(GekkoSession* session, unsigned int timeout)
 {
+    Gekko::Memory::Scope scope(session->memory);
     session->SetDisconnectTimeout(timeout);
 }
 
 void gekko_set_local_delay(GekkoSession* session, int player, unsigned char delay)
 {
+    Gekko::Memory::Scope scope(session->memory);
     session->SetLocalDelay(player, delay);
 }
 
+void gekko_set_adaptive_delay(GekkoSession* session, GekkoAdaptiveDelay* settings)
+{
+    Gekko::Memory::Scope scope(session->memory);
+    session->SetAdaptiveDelay(settings);
+}
+
 void gekko_set_runahead(GekkoSession* session, unsigned char runahead)
 {
+    Gekko::Memory::Scope scope(session->memory);
     session->SetRunahead(runahead);
 }
 
+void gekko_set_runahead_instance(GekkoSession* session, bool enabled)
+{
+    Gekko::Memory::Scope scope(session->memory);
+    session->SetRunaheadInstance(enabled);
+}
+
+void gekko_set_adaptive_runahead(GekkoSession* session, GekkoAdaptiveRunahead* settings)
+{
+    Gekko::Memory::Scope scope(session->memory);
+    session->SetAdaptiveRunahead(settings);
+}
+
+void gekko_report_sim_time(GekkoSession* session, unsigned int time_us)
+{
+    Gekko::Memory::Scope scope(session->memory);
+    session->ReportSimTime(time_us);
+}
+
+void gekko_set_catch_up(GekkoSession* session, unsigned char max_frames)
+{
+    Gekko::Memory::Scope scope(session->memory);
+    session->SetCatchUp(max_frames);
+}
+
+void gekko_set_rollback_budget(GekkoSession* session, unsigned char frames)
+{
+    Gekko::Memory::Scope scope(session->memory);
+    session->SetRollbackBudget(frames);
+}
+
+void gekko_set_prediction_window(GekkoSession* session, unsigned char window)
+{
+    Gekko::Memory::Scope scope(session->memory);
+    session->SetPredictionWindow(window);
+}
+
+void gekko_set_adaptive_prediction_window(GekkoSession* session, GekkoAdaptivePredictionWindow* settings)
+{
+    Gekko::Memory::Scope scope(session->memory);
+    session->SetAdaptivePredictionWindow(settings);
+}
+
 void gekko_add_local_input(GekkoSession* session, int player, void* input)
 {
+    Gekko::Memory::Scope scope(session->memory);
     session->AddLocalInput(player, input);
 }
 
+bool gekko_acquire_local_input(GekkoSession* session, int player, void** input)
+{
+    Gekko::Memory::Scope scope(session->memory);
+    *input = session->AcquireLocalInput(player);
+    return *input != nullptr;
+}
+
+void gekko_commit_local_inputs(GekkoSession* session)
+{
+    Gekko::Memory::Scope scope(session->memory);
+    session->CommitLocalInputs();
+}
+
 GekkoGameEvent** gekko_update_session(GekkoSession* session, int* count)
 {
+    Gekko::Memory::Scope scope(session->memory);
     return session->UpdateSession(count);
 }
 
+void gekko_set_sim_callbacks(GekkoSession* session, GekkoSimCallbacks* callbacks)
+{
+    Gekko::Memory::Scope scope(session->memory);
+    session->SetSimCallbacks(callbacks);
+}
+
+void gekko_set_speculation(GekkoSession* session, GekkoSpeculationCallbacks* callbacks, unsigned char num_branches)
+{
+    Gekko::Memory::Scope scope(session->memory);
+    session->SetSpeculation(callbacks, num_branches);
+}
+
 GekkoSessionEvent** gekko_session_events(GekkoSession* session, int* count)
 {
+    Gekko::Memory::Scope scope(session->memory);
     return session->Events(count);
 }
 
 float gekko_frames_ahead(GekkoSession* session)
 {
+    Gekko::Memory::Scope scope(session->memory);
     return session->FramesAhead();
 }
 
+int gekko_session_start_time(GekkoSession* session)
+{
+    Gekko::Memory::Scope scope(session->memory);
+    return session->StartTime();
+}
+
+void gekko_timing_advice(GekkoSession* session, GekkoTimingAdvice* advice)
+{
+    Gekko::Memory::Scope scope(session->memory);
+    session->TimingAdvice(advice);
+}
+
 void gekko_network_stats(GekkoSession* session, int player, GekkoNetworkStats* stats)
 {
+    Gekko::Memory::Scope scope(session->memory);
     session->NetworkStats(player, stats);
 }
 
 void gekko_network_poll(GekkoSession* session)
 {
+    Gekko::Memory::Scope scope(session->memory);
     session->NetworkPoll();
 }
 
+void gekko_memory_report(GekkoSession* session, GekkoMemoryReport* report)
+{
+    Gekko::Memory::Report(session->memory, report);
+}
+
+void gekko_set_allocation_hook(GekkoSession* session, GekkoAllocationHook hook, void* user_data)
+{
+    session->memory->hook = hook;
+    session->memory->hook_user_data = user_data;
+}
+
 #ifndef GEKKONET_NO_ASIO
 
 #ifdef _WIN32
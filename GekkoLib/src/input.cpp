@@ -16,6 +16,10 @@ Gekko::InputBuffer::InputBuffer() {
 	_last_received_input = GameInput::NULL_FRAME;
 	_last_predicted_input = GameInput::NULL_FRAME;
 	_first_predicted_input = GameInput::NULL_FRAME;
+	_acquired_input = GameInput::NULL_FRAME;
+
+    _prediction_hits = 0;
+    _prediction_misses = 0;
 
     _incorrent_predicted_inputs.clear();
 }
@@ -31,27 +35,67 @@ void Gekko::InputBuffer::Init(u8 delay, u8 input_window, u32 input_size, u32 buf
 
 	_last_predicted_input = GameInput::NULL_FRAME;
 	_first_predicted_input = GameInput::NULL_FRAME;
+	_acquired_input = GameInput::NULL_FRAME;
 
     _incorrent_predicted_inputs.clear();
 
 	// init GameInput array
-    _empty_input = std::make_unique<u8[]>(_input_size);
+    _empty_input = MakeUniqueArray<u8, MemInput>(_input_size);
     std::memset(_empty_input.get(), 0, _input_size);
 
 	for (u32 i = 0; i < _buff_size; i++) {
-        _inputs.push_back(std::make_unique<GameInput>());
+        _inputs.push_back(MakeUnique<GameInput, MemInput>());
 		_inputs[i]->Init(GameInput::NULL_FRAME, _empty_input.get(), _input_size);
 	}
 }
 
 void Gekko::InputBuffer::AddLocalInput(Frame frame, u8* input)
+{
+	AddDelayInputs(frame);
+	AddInput(frame + _input_delay, input);
+}
+
+u8* Gekko::InputBuffer::AcquireLocalInput(Frame frame)
+{
+	AddDelayInputs(frame);
+
+	const Frame target = frame + _input_delay;
+
+	// same as AddInput, only sequential inputs make it into the buffer, the caller is told the input would be dropped.
+	if (target != _last_received_input + 1) {
+		_acquired_input = GameInput::NULL_FRAME;
+		return nullptr;
+	}
+
+	_acquired_input = target;
+	return _inputs[target % _buff_size]->input.get();
+}
+
+void Gekko::InputBuffer::CommitLocalInput()
+{
+	if (_acquired_input == GameInput::NULL_FRAME) {
+		return;
+	}
+
+	// the input was written into the slot in place, all thats left is claiming it.
+	// local inputs are never predicted so theres no prediction to verify.
+	if (_acquired_input == _last_received_input + 1) {
+		auto& slot = _inputs[_acquired_input % _buff_size];
+		slot->frame = _acquired_input;
+		slot->input_len = _input_size;
+		_last_received_input++;
+	}
+
+	_acquired_input = GameInput::NULL_FRAME;
+}
+
+void Gekko::InputBuffer::AddDelayInputs(Frame frame)
 {
 	if (_inputs[frame % _buff_size]->frame == GameInput::NULL_FRAME && _input_delay > 0) {
 		for (i32 i = 0; i < _input_delay; i++) {
 			AddInput(i,  _empty_input.get());
 		}
 	}
-	AddInput(frame + _input_delay, input);
 }
 
 void Gekko::InputBuffer::AddInput(Frame frame, u8* input)
@@ -66,6 +110,7 @@ void Gekko::InputBuffer::AddInput(Frame frame, u8* input)
         if (!_inputs[idx]->IsEqualTo(input)) {
             // incorrect prediction
             _incorrent_predicted_inputs.push_back(_first_predicted_input);
+            _prediction_misses++;
 
             // last prediction frame ? add correct input and reset prediction
             if (_first_predicted_input == _last_predicted_input) {
@@ -86,6 +131,7 @@ void Gekko::InputBuffer::AddInput(Frame frame, u8* input)
         } else {
 
             // correct prediction
+            _prediction_hits++;
             if (_first_predicted_input == _last_predicted_input) {
                 ResetPrediction();
             } else {
@@ -199,6 +245,14 @@ void Gekko::InputBuffer::ClearIncorrectFrames(Frame clear_limit)
 }
 
 
+void Gekko::InputBuffer::TakePredictionCounts(u32& hits, u32& misses)
+{
+    hits = _prediction_hits;
+    misses = _prediction_misses;
+    _prediction_hits = 0;
+    _prediction_misses = 0;
+}
+
 bool Gekko::InputBuffer::HandleInputPrediction(Frame frame)
 {
 	const u32 prev_input = PreviousFrame(frame);
@@ -236,6 +290,26 @@ bool Gekko::InputBuffer::CanPredictInput() {
 	return _input_prediction_window > 0 && diff < _input_prediction_window;
 }
 
+void Gekko::InputBuffer::RepeatLastInput(Frame up_to)
+{
+	if (_last_received_input == GameInput::NULL_FRAME) {
+		return;
+	}
+
+	u8* prev = _inputs[_last_received_input % _buff_size]->input.get();
+
+	while (_last_received_input < up_to) {
+		AddInput(_last_received_input + 1, prev);
+	}
+}
+
+void Gekko::InputBuffer::PadEmptyInput(Frame up_to)
+{
+	while (_last_received_input < up_to) {
+		AddInput(_last_received_input + 1, _empty_input.get());
+	}
+}
+
 u32 Gekko::InputBuffer::PreviousFrame(Frame frame)
 {
 	return frame - 1 < 0 ? _buff_size - frame - 1 : frame - 1;
@@ -246,40 +320,48 @@ void Gekko::InputBuffer::SetRunaheadMode(bool running_ahead)
     _running_ahead = running_ahead;
 }
 
-std::unique_ptr<Gekko::GameInput> Gekko::InputBuffer::GetInput(Frame frame, bool prediction)
+Gekko::GameInput* Gekko::InputBuffer::GetInput(Frame frame, bool prediction)
 {
-    auto inp = std::make_unique<GameInput>();
-
 	if (_last_received_input < frame) {
 		// no input? check if we should predict the input
 		if (prediction) {
             if (_last_predicted_input != GameInput::NULL_FRAME &&
                 frame <= _last_predicted_input) {
                 // return existing prediction
-                inp->Init(_inputs[frame % _buff_size].get());
+                return _inputs[frame % _buff_size].get();
 
             } else if (!_running_ahead && CanPredictInput() && HandleInputPrediction(frame)) {
                 // generate new prediction
-				inp->Init(_inputs[frame % _buff_size].get());
+				return _inputs[frame % _buff_size].get();
 
             } else if (_running_ahead) {
                 // return last known input without advancing prediction state
                 const Frame ref = _last_predicted_input != GameInput::NULL_FRAME ? _last_predicted_input : _last_received_input;
                 if (ref != GameInput::NULL_FRAME) {
-                    inp->Init(_inputs[ref % _buff_size].get());
+                    return _inputs[ref % _buff_size].get();
                 }
             }
 		}
-		return inp;
+		return &_missing_input;
 	}
 
     if (_inputs[frame % _buff_size]->frame != frame ||
         _inputs[frame % _buff_size]->frame == GameInput::NULL_FRAME) {
-        return inp;
+        return &_missing_input;
     }
 
-	inp->Init(_inputs[frame % _buff_size].get());
-	return inp;
+	return _inputs[frame % _buff_size].get();
+}
+
+u8* Gekko::InputBuffer::GetInputData(Frame frame)
+{
+	// a view of the stored input, only valid until the ring wraps around.
+	if (frame < 0 || frame > _last_received_input) {
+		return nullptr;
+	}
+
+	auto& slot = _inputs[frame % _buff_size];
+	return slot->frame == frame ? slot->input.get() : nullptr;
 }
 
 void Gekko::GameInput::Init(GameInput* other)
@@ -292,7 +374,7 @@ void Gekko::GameInput::Init(GameInput* other)
 		return;
 	}
 
-	input = std::make_unique<u8[]>(input_len);
+	input = MakeUniqueArray<u8, MemInput>(input_len);
 
     if (input) {
         std::memcpy(input.get(), other->input.get(), input_len);
@@ -309,7 +391,7 @@ void Gekko::GameInput::Init(Frame frame_num, u8* inp, u32 inp_len)
 		return;
 	}
 
-	input = std::make_unique<u8[]>(input_len);
+	input = MakeUniqueArray<u8, MemInput>(input_len);
 
     if (input) {
         std::memcpy(input.get(), inp, input_len);
@@ -331,5 +413,5 @@ Gekko::GameInput::GameInput()
 {
 	frame = NULL_FRAME;
 	input_len = 0;
-	input = std::unique_ptr<u8[]>();
+	input.reset();
 }
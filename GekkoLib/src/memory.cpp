@@ -0,0 +1,371 @@
+#include "memory.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace Gekko {
+    struct MemSlab {
+        MemSlab* next;
+        void* raw;
+        size_t size;
+    };
+}
+
+namespace {
+    struct BlockHeader {
+        Gekko::MemContext* ctx;
+        // the pointer the allocator returned when the block had to be page aligned.
+        void* raw;
+        size_t size;
+        Gekko::MemTag tag;
+        u8 size_class;
+    };
+
+    // keep the memory handed out aligned for any type.
+    constexpr size_t HEADER_SIZE =
+        (sizeof(BlockHeader) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+    constexpr u8 NO_CLASS = UINT8_MAX;
+    constexpr size_t MIN_CLASS_SIZE = 64;
+    constexpr size_t SLAB_SIZE = 64 * 1024;
+
+    void* DefaultAlloc(void*, size_t size) {
+        return std::malloc(size);
+    }
+
+    void DefaultFree(void*, void* ptr) {
+        std::free(ptr);
+    }
+
+    // used for allocations outside of any session call, these are not accounted.
+    Gekko::MemContext _heap_context = { { nullptr, DefaultAlloc, DefaultFree } };
+
+    thread_local Gekko::MemContext* _current = nullptr;
+
+    BlockHeader* GetHeader(void* ptr) {
+        return reinterpret_cast<BlockHeader*>(static_cast<u8*>(ptr) - HEADER_SIZE);
+    }
+
+    size_t PageSize() {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return info.dwPageSize;
+#else
+        return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+    }
+
+    size_t AlignUp(size_t value, size_t align) {
+        return (value + align - 1) & ~(align - 1);
+    }
+
+    void LockPages(void* ptr, size_t size) {
+#ifdef _WIN32
+        VirtualLock(ptr, size);
+#else
+        mlock(ptr, size);
+#endif
+    }
+
+    void UnlockPages(void* ptr, size_t size) {
+#ifdef _WIN32
+        VirtualUnlock(ptr, size);
+#else
+        munlock(ptr, size);
+#endif
+    }
+
+    u8 SizeClassOf(size_t block_size) {
+        size_t class_size = MIN_CLASS_SIZE;
+        for (u8 i = 0; i < Gekko::MemContext::NUM_CLASSES; i++) {
+            if (block_size <= class_size) {
+                return i;
+            }
+            class_size <<= 1;
+        }
+        return NO_CLASS;
+    }
+
+    size_t ClassSize(u8 size_class) {
+        return MIN_CLASS_SIZE << size_class;
+    }
+
+    void NoteSteadyAlloc(Gekko::MemContext* ctx, size_t size, Gekko::MemTag tag) {
+        if (!ctx->steady) {
+            return;
+        }
+
+        ctx->steady_allocs++;
+
+        if (ctx->hook) {
+            ctx->hook(ctx->hook_user_data, size, (GekkoMemoryTag)tag);
+        }
+    }
+
+    // takes memory from the allocator, in pooled mode it gets prefaulted and optionally locked.
+    void* RawAlloc(Gekko::MemContext* ctx, size_t size, void*& raw) {
+        raw = nullptr;
+
+        if (!ctx->lock) {
+            void* mem = ctx->allocator.alloc(ctx->allocator.user_data, size);
+            if (!mem) {
+                throw std::bad_alloc();
+            }
+            if (ctx->pooled) {
+                std::memset(mem, 0, size);
+            }
+            return mem;
+        }
+
+        // page align locked memory so unlocking it later doesnt affect anything else.
+        const size_t page = PageSize();
+        const size_t locked_size = AlignUp(size, page);
+
+        raw = ctx->allocator.alloc(ctx->allocator.user_data, locked_size + page);
+        if (!raw) {
+            throw std::bad_alloc();
+        }
+
+        u8* mem = (u8*)AlignUp((uintptr_t)raw, page);
+        std::memset(mem, 0, locked_size);
+        LockPages(mem, locked_size);
+        return mem;
+    }
+
+    void RawFree(Gekko::MemContext* ctx, void* mem, void* raw, size_t size) {
+        if (raw) {
+            UnlockPages(mem, AlignUp(size, PageSize()));
+            ctx->allocator.free(ctx->allocator.user_data, raw);
+            return;
+        }
+
+        ctx->allocator.free(ctx->allocator.user_data, mem);
+    }
+
+    Gekko::MemSlab* NewSlab(Gekko::MemContext* ctx) {
+        void* raw = nullptr;
+        u8* mem = (u8*)RawAlloc(ctx, SLAB_SIZE, raw);
+
+        auto slab = reinterpret_cast<Gekko::MemSlab*>(mem);
+        slab->raw = raw;
+        slab->size = SLAB_SIZE;
+        slab->next = nullptr;
+
+        ctx->reserved_bytes += SLAB_SIZE;
+        return slab;
+    }
+
+    void* PoolAlloc(Gekko::MemContext* ctx, u8 size_class, Gekko::MemTag tag) {
+        void*& head = ctx->free_lists[size_class];
+        if (head) {
+            void* block = head;
+            head = *static_cast<void**>(block);
+            return block;
+        }
+
+        const size_t class_size = ClassSize(size_class);
+
+        if (!ctx->slab_cursor || ctx->slab_cursor + class_size > ctx->slab_end) {
+            Gekko::MemSlab* slab = ctx->spare_slabs;
+            if (slab) {
+                ctx->spare_slabs = slab->next;
+            }
+            else {
+                NoteSteadyAlloc(ctx, SLAB_SIZE, tag);
+                slab = NewSlab(ctx);
+            }
+
+            slab->next = ctx->slabs;
+            ctx->slabs = slab;
+
+            ctx->slab_cursor = (u8*)slab + AlignUp(sizeof(Gekko::MemSlab), alignof(std::max_align_t));
+            ctx->slab_end = (u8*)slab + slab->size;
+        }
+
+        void* block = ctx->slab_cursor;
+        ctx->slab_cursor += class_size;
+        return block;
+    }
+
+    void ReleaseSlabs(Gekko::MemContext* ctx, Gekko::MemSlab* slab) {
+        while (slab) {
+            Gekko::MemSlab* next = slab->next;
+            RawFree(ctx, slab, slab->raw, slab->size);
+            slab = next;
+        }
+    }
+}
+
+Gekko::MemContext* Gekko::Memory::CreateContext(GekkoAllocator* allocator)
+{
+    GekkoAllocator alloc = allocator ? *allocator : _heap_context.allocator;
+
+    void* mem = alloc.alloc(alloc.user_data, sizeof(MemContext));
+    if (!mem) {
+        throw std::bad_alloc();
+    }
+
+    auto ctx = new (mem) MemContext();
+    ctx->allocator = alloc;
+    return ctx;
+}
+
+void Gekko::Memory::DestroyContext(MemContext* ctx)
+{
+    ReleaseSlabs(ctx, ctx->slabs);
+    ReleaseSlabs(ctx, ctx->spare_slabs);
+
+    GekkoAllocator alloc = ctx->allocator;
+    ctx->~MemContext();
+    alloc.free(alloc.user_data, ctx);
+}
+
+void* Gekko::Memory::Alloc(size_t size, MemTag tag)
+{
+    MemContext* ctx = Current();
+
+    const u8 size_class = ctx->pooled ? SizeClassOf(HEADER_SIZE + size) : NO_CLASS;
+
+    void* mem = nullptr;
+    void* raw = nullptr;
+
+    if (size_class != NO_CLASS) {
+        mem = PoolAlloc(ctx, size_class, tag);
+    }
+    else {
+        NoteSteadyAlloc(ctx, size, tag);
+        mem = RawAlloc(ctx, HEADER_SIZE + size, raw);
+    }
+
+    auto header = static_cast<BlockHeader*>(mem);
+    header->ctx = ctx;
+    header->raw = raw;
+    header->size = size;
+    header->tag = tag;
+    header->size_class = size_class;
+
+    if (ctx != &_heap_context) {
+        ctx->bytes[tag] += size;
+        ctx->total_bytes += size;
+        ctx->num_allocs++;
+        if (ctx->total_bytes > ctx->peak_bytes) {
+            ctx->peak_bytes = ctx->total_bytes;
+        }
+    }
+
+    return static_cast<u8*>(mem) + HEADER_SIZE;
+}
+
+void Gekko::Memory::Free(void* ptr)
+{
+    if (!ptr) {
+        return;
+    }
+
+    BlockHeader* header = GetHeader(ptr);
+    MemContext* ctx = header->ctx;
+
+    if (ctx != &_heap_context) {
+        ctx->bytes[header->tag] -= header->size;
+        ctx->total_bytes -= header->size;
+        ctx->num_allocs--;
+    }
+
+    if (header->size_class != NO_CLASS) {
+        void*& head = ctx->free_lists[header->size_class];
+        *reinterpret_cast<void**>(header) = head;
+        head = header;
+        return;
+    }
+
+    RawFree(ctx, header, header->raw, HEADER_SIZE + header->size);
+}
+
+size_t Gekko::Memory::SizeOf(void* ptr)
+{
+    return GetHeader(ptr)->size;
+}
+
+Gekko::MemContext* Gekko::Memory::Current()
+{
+    return _current ? _current : &_heap_context;
+}
+
+void Gekko::Memory::EnablePooling(MemContext* ctx, bool lock)
+{
+    ctx->pooled = true;
+    ctx->lock = lock;
+}
+
+void Gekko::Memory::Reserve(MemContext* ctx, size_t bytes)
+{
+    size_t available = (size_t)(ctx->slab_end - ctx->slab_cursor);
+    for (MemSlab* slab = ctx->spare_slabs; slab; slab = slab->next) {
+        available += slab->size;
+    }
+
+    while (available < bytes) {
+        MemSlab* slab = NewSlab(ctx);
+        slab->next = ctx->spare_slabs;
+        ctx->spare_slabs = slab;
+        available += slab->size;
+    }
+}
+
+void Gekko::Memory::Prefault(void* ptr)
+{
+    BlockHeader* header = GetHeader(ptr);
+
+    // touch every page so the first real write doesnt fault.
+    volatile u8* bytes = static_cast<u8*>(ptr);
+    const size_t page = PageSize();
+    for (size_t i = 0; i < header->size; i += page) {
+        bytes[i] = bytes[i];
+    }
+}
+
+void Gekko::Memory::MarkSteady()
+{
+    MemContext* ctx = Current();
+    if (ctx != &_heap_context && ctx->pooled) {
+        ctx->steady = true;
+    }
+}
+
+void Gekko::Memory::Report(MemContext* ctx, GekkoMemoryReport* report)
+{
+    report->total_bytes = ctx->total_bytes;
+    report->peak_bytes = ctx->peak_bytes;
+    report->num_allocations = ctx->num_allocs;
+    report->reserved_bytes = ctx->reserved_bytes;
+    report->steady_allocations = ctx->steady_allocs;
+
+    for (u32 i = 0; i < MemTagCount; i++) {
+        report->bytes[i] = ctx->bytes[i];
+    }
+}
+
+Gekko::Memory::Scope::Scope(MemContext* ctx)
+{
+    _prev = _current;
+    _current = ctx;
+}
+
+Gekko::Memory::Scope::~Scope()
+{
+    _current = _prev;
+}
@@ -12,15 +12,15 @@ u32 Gekko::NetAddress::GetSize()
 
 Gekko::NetAddress::NetAddress(void* data, u32 size)
 {
-    _size = size;
-    _data = std::make_unique<u8[]>(_size);
-    // copy address data
-    std::memcpy(_data.get(), data, _size);
+    _size = 0;
+    _capacity = 0;
+    Set(data, size);
 }
 
 Gekko::NetAddress::NetAddress()
 {
     _size = 0;
+    _capacity = 0;
     _data = nullptr;
 }
 
@@ -30,15 +30,26 @@ void Gekko::NetAddress::Copy(NetAddress* other)
         return;
     }
 
-    _size = other->_size;
+    Set(other->GetAddress(), other->_size);
+}
 
-    if (_data) {
-        _data.reset();
+void Gekko::NetAddress::Set(void* data, u32 size)
+{
+    if (size > _capacity) {
+        _data = MakeUniqueArray<u8, MemNetwork>(size);
+        _capacity = size;
     }
 
-    _data = std::make_unique<u8[]>(_size);
+    _size = size;
     // copy address data
-    std::memcpy(_data.get(), other->GetAddress(), _size);
+    if (_size > 0) {
+        std::memcpy(_data.get(), data, _size);
+    }
+}
+
+void Gekko::NetAddress::Clear()
+{
+    _size = 0;
 }
 
 bool Gekko::NetAddress::Equals(NetAddress& other)
@@ -117,3 +128,14 @@ u32 Gekko::NetStats::LastRTT()
 
     return rtt.back();
 }
+
+u64 Gekko::NetStats::InputRetryInterval()
+{
+    if (rtt.empty()) {
+        return INPUT_RETRY_INTERVAL;
+    }
+
+    // an input still unacked a round trip and some jitter after it went out was most likely lost.
+    const u64 interval = (u64)(CalculateAvgRTT() + CalculateJitter() * 2.f) + INPUT_RETRY_MARGIN;
+    return interval < INPUT_RETRY_INTERVAL ? interval : INPUT_RETRY_INTERVAL;
+}
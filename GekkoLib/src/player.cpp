@@ -12,6 +12,8 @@ Gekko::Player::Player(Handle phandle, GekkoPlayerType type, NetAddress* addr, u3
 	stats.last_acked_frame = -1;
 	stats.last_sent_sync_message = 0;
 
+	peer = PeerTable::INVALID_PEER;
+
 	_type = type;
 	_status = _type == GekkoLocalPlayer ? Connected : Initiating;
 	adv_history.Init();
@@ -27,8 +27,11 @@ void Gekko::SpectatorSession::Init(GekkoConfig* config)
     // setup message system.
     _msg.Init(_config.num_players, _config.input_size);
 
-    // setup game event system
-    _game_events.Init(_config.input_size * _config.num_players);
+    // setup game event system, spectators only ever advance a single frame.
+    _game_events.Init(_config.input_size * _config.num_players, 1, 0);
+
+    // setup session event system for the host.
+    _msg.session_events.Init(SessionEventSystem::EVENTS_PER_ACTOR);
 
     // start paused so the buffer fills before playback begins
     _delay_spectator = (_config.spectator_delay > 0);
@@ -47,7 +50,7 @@ void Gekko::SpectatorSession::SetNetAdapter(GekkoNetAdapter* adapter)
 i32 Gekko::SpectatorSession::AddActor(GekkoPlayerType type, GekkoNetAddress* addr)
 {
     const i32 ERR = -1;
-    std::unique_ptr<NetAddress> address;
+    UniquePtr<NetAddress> address;
 
     // only accept a single remote player (the host)
     if (type != GekkoRemotePlayer) {
@@ -62,10 +65,10 @@ i32 Gekko::SpectatorSession::AddActor(GekkoPlayerType type, GekkoNetAddress* add
         return ERR;
     }
 
-    address = std::make_unique<NetAddress>(addr->data, addr->size);
+    address = MakeUnique<NetAddress, MemNetwork>(addr->data, addr->size);
 
     u32 new_handle = (u32)_msg.remotes.size();
-    _msg.remotes.push_back(std::make_unique<Player>(new_handle, type, address.get()));
+    _msg.AddActor(new_handle, type, address.get());
 
     return new_handle;
 }
@@ -96,6 +99,17 @@ void Gekko::SpectatorSession::AddLocalInput(i32 player, void* input)
     // no-op: spectators don't add local input
 }
 
+void* Gekko::SpectatorSession::AcquireLocalInput(i32 player)
+{
+    // no-op: spectators don't add local input
+    return nullptr;
+}
+
+void Gekko::SpectatorSession::CommitLocalInputs()
+{
+    // no-op: spectators don't add local input
+}
+
 GekkoGameEvent** Gekko::SpectatorSession::UpdateSession(i32* count)
 {
     // reset session events
@@ -128,6 +142,11 @@ GekkoGameEvent** Gekko::SpectatorSession::UpdateSession(i32* count)
     return _game_events.Data();
 }
 
+void Gekko::SpectatorSession::SetSimCallbacks(GekkoSimCallbacks* callbacks)
+{
+    _game_events.SetCallbacks(callbacks);
+}
+
 GekkoSessionEvent** Gekko::SpectatorSession::Events(i32* count)
 {
     *count = (i32)_msg.session_events.GetRecentEvents().size();
@@ -139,6 +158,19 @@ f32 Gekko::SpectatorSession::FramesAhead()
     return 0.f;
 }
 
+i32 Gekko::SpectatorSession::StartTime()
+{
+    // spectators start as soon as the host is connected.
+    return _started ? 0 : -1;
+}
+
+void Gekko::SpectatorSession::TimingAdvice(GekkoTimingAdvice* advice)
+{
+    // spectators follow the host through their delay buffer, theres nothing to pace against.
+    *advice = GekkoTimingAdvice();
+    advice->tick_rate_scale = 1.f;
+}
+
 void Gekko::SpectatorSession::NetworkStats(i32 player, GekkoNetworkStats* stats)
 {
     for (auto& actor : _msg.remotes) {
@@ -197,6 +229,8 @@ bool Gekko::SpectatorSession::AllActorsValid()
         }
         _started = true;
 
+        Memory::MarkSteady();
+
 		return true;
 	}
 
@@ -209,13 +243,8 @@ void Gekko::SpectatorSession::HandleReceivedInputs()
         if (remote->GetStatus() != Connected) continue;
 
         // spectators receive combined inputs for ALL players from the host
-        std::vector<Handle> handles;
         for (u32 i = 0; i < _config.num_players; i++) {
-            handles.push_back(i);
-        }
-
-        for (u32 i = 0; i < handles.size(); i++) {
-            auto handle = handles[i];
+            const Handle handle = i;
             const Frame last_recv = _sync.GetLastReceivedFrom(handle) + 1;
             const Frame last_added = _msg.GetLastAddedInputFrom(handle);
 
@@ -224,9 +253,9 @@ void Gekko::SpectatorSession::HandleReceivedInputs()
             for (int i = last_recv; i <= last_added; i++) {
                 if (i >= min_frame) {
                     int current_idx = i - min_frame;
-                    u8* input = input_q[current_idx].get();
+                    u8* input = input_q[current_idx];
                     _sync.AddRemoteInput(handle, input, i);
-                    _msg.SendInputAck(handle, i, 0);
+                    _msg.QueueInputAck(handle, i, 0, 0);
                 }
             }
         }
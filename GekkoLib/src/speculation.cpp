@@ -0,0 +1,189 @@
+#include "speculation.h"
+
+#include <algorithm>
+#include <cstring>
+
+Gekko::SpeculationSystem::~SpeculationSystem()
+{
+    Stop();
+}
+
+void Gekko::SpeculationSystem::Init(GekkoSpeculationCallbacks* callbacks, u8 num_branches, u32 input_size, u32 state_size)
+{
+    Stop();
+
+    _callbacks = *callbacks;
+    _input_size = input_size;
+    _state_size = state_size;
+    _frame = GameInput::NULL_FRAME;
+    _num_hypotheses = 0;
+
+    const u32 count = num_branches > MAX_BRANCHES ? MAX_BRANCHES : num_branches;
+
+    _base_state = MakeUniqueArray<u8, MemStorage>(_state_size);
+    _hypotheses = MakeUniqueArray<u8, MemInput>((size_t)count * _input_size);
+    _branches = MakeUniqueArray<SpeculativeBranch, MemStorage>(count);
+
+    for (u32 i = 0; i < count; i++) {
+        _branches[i].state = MakeUniqueArray<u8, MemStorage>(_state_size);
+    }
+
+    _quit = false;
+    _running = 0;
+
+    _workers.reserve(count);
+    for (u32 i = 0; i < count; i++) {
+        _workers.emplace_back(&SpeculationSystem::WorkerLoop, this, i, _generation);
+    }
+}
+
+void Gekko::SpeculationSystem::Stop()
+{
+    if (_workers.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+    }
+    _wake.notify_all();
+
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+
+    _workers.clear();
+    _frame = GameInput::NULL_FRAME;
+    _num_hypotheses = 0;
+    _running = 0;
+}
+
+bool Gekko::SpeculationSystem::IsActive() const
+{
+    return !_workers.empty();
+}
+
+Frame Gekko::SpeculationSystem::GetFrame() const
+{
+    return _frame;
+}
+
+void Gekko::SpeculationSystem::Launch(Frame frame, u8* predicted, StateEntry* base)
+{
+    // the branches of the previous frame might still be working on the buffers.
+    Wait();
+
+    _frame = GameInput::NULL_FRAME;
+    _num_hypotheses = 0;
+
+    if (!_callbacks.hypotheses || !_callbacks.branch_advance) {
+        return;
+    }
+
+    const i32 max = (i32)_workers.size();
+    const i32 count = std::clamp(
+        _callbacks.hypotheses(_callbacks.user_data, frame, predicted, _input_size, _hypotheses.get(), max), 0, max
+    );
+
+    if (count == 0) {
+        return;
+    }
+
+    _base_len = std::min(base->state_len, _state_size);
+    std::memcpy(_base_state.get(), base->state.get(), _base_len);
+
+    for (i32 i = 0; i < count; i++) {
+        auto& branch = _branches[i];
+        branch.state_len = _state_size;
+        branch.checksum = 0;
+
+        branch.desc.frame = frame;
+        branch.desc.input_len = _input_size;
+        branch.desc.inputs = _hypotheses.get() + (size_t)i * _input_size;
+        branch.desc.state_len = _base_len;
+        branch.desc.state = _base_state.get();
+        branch.desc.out_state_len = &branch.state_len;
+        branch.desc.out_checksum = &branch.checksum;
+        branch.desc.out_state = branch.state.get();
+    }
+
+    _frame = frame;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _num_hypotheses = (u32)count;
+        _running = (u32)count;
+        _generation++;
+    }
+    _wake.notify_all();
+}
+
+bool Gekko::SpeculationSystem::Adopt(Frame frame, u8* inputs, StateEntry* target)
+{
+    if (_frame == GameInput::NULL_FRAME || _frame != frame) {
+        Discard();
+        return false;
+    }
+
+    Wait();
+    Discard();
+
+    for (u32 i = 0; i < _num_hypotheses; i++) {
+        auto& branch = _branches[i];
+        if (std::memcmp(branch.desc.inputs, inputs, _input_size) != 0) {
+            continue;
+        }
+
+        const u32 len = std::min(branch.state_len, _state_size);
+        std::memcpy(target->state.get(), branch.state.get(), len);
+        target->state_len = len;
+        target->checksum = branch.checksum;
+        target->frame = frame;
+        target->valid = true;
+        return true;
+    }
+
+    return false;
+}
+
+void Gekko::SpeculationSystem::Discard()
+{
+    // the branches keep running, their buffers are only reused after waiting on them.
+    _frame = GameInput::NULL_FRAME;
+}
+
+void Gekko::SpeculationSystem::Wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done.wait(lock, [this] { return _running == 0; });
+}
+
+void Gekko::SpeculationSystem::WorkerLoop(u32 index, u32 generation)
+{
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [&] { return _quit || _generation != generation; });
+
+            if (_quit) {
+                return;
+            }
+
+            generation = _generation;
+
+            if (index >= _num_hypotheses) {
+                continue;
+            }
+        }
+
+        _callbacks.branch_advance(_callbacks.user_data, &_branches[index].desc);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_running == 0) {
+                _done.notify_all();
+            }
+        }
+    }
+}
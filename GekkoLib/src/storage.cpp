@@ -1,8 +1,75 @@
 #include "storage.h"
 
+#include <algorithm>
+#include <cstring>
+
+namespace {
+	using Ring = Gekko::Vector<Gekko::UniquePtr<Gekko::StateEntry>, Gekko::MemStorage>;
+
+	u32 RingIndex(Frame frame, u32 num)
+	{
+		return (frame < 0 ? frame + num : frame) % num;
+	}
+
+	// rebuilds a ring with a different size, the newest states move to their new slots.
+	void ResizeRing(Ring& ring, u32 num, u32 state_size, u32 input_size)
+	{
+		Ring old = std::move(ring);
+		std::sort(old.begin(), old.end(), [](const auto& a, const auto& b) {
+			return a->valid != b->valid ? a->valid : a->frame > b->frame;
+		});
+
+		ring.clear();
+		ring.resize(num);
+
+		Ring spare;
+		for (auto& entry : old) {
+			// only entries never written are spare, the initial save lives at NULL_FRAME as well.
+			if (!entry->valid) {
+				spare.push_back(std::move(entry));
+				continue;
+			}
+
+			const u32 idx = RingIndex(entry->frame, num);
+			if (ring[idx]) {
+				spare.push_back(std::move(entry));
+				continue;
+			}
+
+			ring[idx] = std::move(entry);
+		}
+
+		// reuse what didnt fit for the empty slots before allocating new ones, the rest is released.
+		for (auto& slot : ring) {
+			if (slot) {
+				continue;
+			}
+
+			if (!spare.empty()) {
+				slot = std::move(spare.back());
+				spare.pop_back();
+				slot->frame = Gekko::GameInput::NULL_FRAME;
+				slot->valid = false;
+				continue;
+			}
+
+			slot = Gekko::MakeUnique<Gekko::StateEntry, Gekko::MemStorage>();
+			slot->state = Gekko::MakeUniqueArray<u8, Gekko::MemStorage>(state_size);
+			slot->state_len = state_size;
+
+			if (input_size > 0) {
+				slot->inputs = Gekko::MakeUniqueArray<u8, Gekko::MemStorage>(input_size);
+			}
+		}
+	}
+}
+
 Gekko::StateStorage::StateStorage()
 {
 	_max_num_states = 0;
+	_state_size = 0;
+	_runahead_input_size = 0;
+	_limited = false;
 }
 
 
@@ -10,21 +77,59 @@ void Gekko::StateStorage::Init(u32 num_states, u32 state_size, bool limited)
 {
 	const u32 num = limited ? 2 : num_states + 2;
 	_max_num_states = num;
+	_state_size = state_size;
+	_limited = limited;
 
 	for (u32 i = 0; i < _max_num_states; i++) {
-		_states.push_back(std::make_unique<StateEntry>());
-        _states.back().get()->state = std::make_unique<u8[]>(state_size);
+		_states.push_back(MakeUnique<StateEntry, MemStorage>());
+        _states.back().get()->state = MakeUniqueArray<u8, MemStorage>(state_size);
 		_states.back().get()->state_len = state_size;
 	}
+}
 
-	_runahead_state.state = std::make_unique<u8[]>(state_size);
-	_runahead_state.state_len = state_size;
-	_runahead_state.frame = GameInput::NULL_FRAME;
+void Gekko::StateStorage::Resize(u32 num_states)
+{
+	// limited saving only ever keeps the confirmed and the latest state.
+	const u32 num = _limited ? 2 : num_states + 2;
+	if (num == _max_num_states) {
+		return;
+	}
+
+	ResizeRing(_states, num, _state_size, 0);
+	_max_num_states = num;
 }
 
-Gekko::StateEntry* Gekko::StateStorage::GetRunaheadState()
+void Gekko::StateStorage::ReserveRunahead(u32 num_frames, u32 input_size)
 {
-	return &_runahead_state;
+	if (num_frames <= _runahead_states.size() && input_size == _runahead_input_size) {
+		return;
+	}
+
+	// entries sized for other inputs cant be reused.
+	if (input_size != _runahead_input_size) {
+		_runahead_states.clear();
+		_runahead_input_size = input_size;
+	}
+
+	ResizeRing(_runahead_states, std::max(num_frames, (u32)_runahead_states.size()), _state_size, input_size);
+}
+
+Gekko::StateEntry* Gekko::StateStorage::GetRunaheadState(Frame frame)
+{
+	return _runahead_states[RingIndex(frame, (u32)_runahead_states.size())].get();
+}
+
+void Gekko::StateStorage::AdoptRunaheadState(Frame frame)
+{
+	auto src = GetRunaheadState(frame);
+	auto dst = GetState(frame);
+
+	const u32 len = std::min(src->state_len, _state_size);
+	std::memcpy(dst->state.get(), src->state.get(), len);
+	dst->state_len = len;
+	dst->checksum = src->checksum;
+	dst->frame = frame;
+	dst->valid = true;
 }
 
 Gekko::StateEntry* Gekko::StateStorage::GetState(Frame frame)
@@ -20,8 +20,11 @@ void Gekko::StressSession::Init(GekkoConfig* config)
     // setup input buffer for the players
     _sync.Init(_config.num_players, _config.input_size);
 
-    // setup game event system
-    _game_events.Init(_config.input_size * _config.num_players);
+    // setup game event system for resimulating the check distance each update.
+    _game_events.Init(_config.input_size * _config.num_players, _check_distance + 1, _check_distance + 2);
+
+    // setup session event system, at most one desync per checked frame.
+    _session_events.Init(_check_distance + 1);
 
     // setup state storage
     _storage.Init(_check_distance, _config.state_size, false);
@@ -49,10 +52,10 @@ i32 Gekko::StressSession::AddActor(GekkoPlayerType type, GekkoNetAddress* addr)
     if (type != GekkoLocalPlayer) return -1;
 
     u32 new_handle = (u32)_locals.size();
-    std::unique_ptr<NetAddress> address;
+    UniquePtr<NetAddress> address;
 
     if (addr) {
-        address = std::make_unique<NetAddress>(addr->data, addr->size);
+        address = MakeUnique<NetAddress, MemNetwork>(addr->data, addr->size);
     }
 
     _locals.push_back(Player(new_handle, type, address.get()));
@@ -78,8 +81,29 @@ void Gekko::StressSession::AddLocalInput(i32 player, void* input)
     }
 }
 
+void* Gekko::StressSession::AcquireLocalInput(i32 player)
+{
+    for (u32 i = 0; i < _locals.size(); i++) {
+        if (_locals[i].handle == player) {
+            return _sync.AcquireLocalInput(player);
+        }
+    }
+
+    return nullptr;
+}
+
+void Gekko::StressSession::CommitLocalInputs()
+{
+    for (auto& local : _locals) {
+        _sync.CommitLocalInput(local.handle);
+    }
+}
+
 GekkoGameEvent** Gekko::StressSession::UpdateSession(i32* count)
 {
+    // theres no handshake, the session is running from the first update on.
+    Memory::MarkSteady();
+
     _game_events.Clear();
     _session_events.Reset();
     _game_events.Reset();
@@ -109,6 +133,11 @@ GekkoGameEvent** Gekko::StressSession::UpdateSession(i32* count)
     return _game_events.Data();
 }
 
+void Gekko::StressSession::SetSimCallbacks(GekkoSimCallbacks* callbacks)
+{
+    _game_events.SetCallbacks(callbacks);
+}
+
 GekkoSessionEvent** Gekko::StressSession::Events(i32* count)
 {
     *count = (i32)_session_events.GetRecentEvents().size();
@@ -120,6 +149,18 @@ f32 Gekko::StressSession::FramesAhead()
     return 0.f;
 }
 
+i32 Gekko::StressSession::StartTime()
+{
+    return 0;
+}
+
+void Gekko::StressSession::TimingAdvice(GekkoTimingAdvice* advice)
+{
+    // stress sessions are local only, theres nothing to pace against.
+    *advice = GekkoTimingAdvice();
+    advice->tick_rate_scale = 1.f;
+}
+
 void Gekko::StressSession::NetworkStats(i32 player, GekkoNetworkStats* stats)
 {
     // no stats for now.
@@ -18,7 +18,8 @@ void Gekko::SyncSystem::Init(u8 num_players, u32 input_size, u32 buffer_size)
 	_num_players = num_players;
 	_current_frame = GameInput::NULL_FRAME + 1;
 
-    _input_buffers = std::make_unique<InputBuffer[]>(num_players);
+    _input_buffers = MakeUniqueArray<InputBuffer, MemInput>(num_players);
+    _frame_inputs = MakeUniqueArray<u8, MemInput>(_input_size * _num_players);
 	// on creation setup input buffers
 	for (int i = 0; i < _num_players; i++) {
 		_input_buffers[i].Init(0, 0, input_size, buffer_size);
@@ -35,6 +36,24 @@ void Gekko::SyncSystem::AddLocalInput(Handle player, u8* input)
 	_input_buffers[player].AddLocalInput(_current_frame, input);
 }
 
+u8* Gekko::SyncSystem::AcquireLocalInput(Handle player)
+{
+    if (player >= _num_players || player < 0) {
+        return nullptr;
+    }
+
+	return _input_buffers[player].AcquireLocalInput(_current_frame);
+}
+
+void Gekko::SyncSystem::CommitLocalInput(Handle player)
+{
+    if (player >= _num_players || player < 0) {
+        return;
+    }
+
+	_input_buffers[player].CommitLocalInput();
+}
+
 void Gekko::SyncSystem::AddRemoteInput(Handle player, u8* input, Frame frame)
 {
 	// drop inputs from incorrect handles
@@ -60,9 +79,8 @@ void Gekko::SyncSystem::IncrementFrame()
 	_current_frame++;
 }
 
-bool Gekko::SyncSystem::GetSpectatorInputs(std::unique_ptr<u8[]>& inputs, Frame frame) 
+bool Gekko::SyncSystem::GetSpectatorInputs(u8*& inputs, Frame frame) 
 {
-    auto all_input = std::make_unique<u8[]>(_input_size * _num_players);
 	for (u8 i = 0; i < _num_players; i++) {
 		auto inp = _input_buffers[i].GetInput(frame);
 
@@ -70,9 +88,9 @@ bool Gekko::SyncSystem::GetSpectatorInputs(std::unique_ptr<u8[]>& inputs, Frame
 			return false;
 		}
 
-		std::memcpy(all_input.get() + (i * _input_size), (void*)inp->input.get(), _input_size);
+		std::memcpy(_frame_inputs.get() + (i * _input_size), (void*)inp->input.get(), _input_size);
 	}
-	inputs = std::move(all_input);
+	inputs = _frame_inputs.get();
 	return true;
 }
 
@@ -83,31 +101,30 @@ void Gekko::SyncSystem::SetRunaheadMode(bool running_ahead)
     }
 }
 
-bool Gekko::SyncSystem::GetCurrentInputs(std::unique_ptr<u8[]>& inputs, Frame& frame)
+bool Gekko::SyncSystem::GetCurrentInputs(u8*& inputs, Frame& frame)
+{
+	frame = _current_frame;
+	return GetFrameInputs(inputs, _current_frame);
+}
+
+bool Gekko::SyncSystem::GetFrameInputs(u8*& inputs, Frame frame)
 {
-    auto all_input = std::make_unique<u8[]>(_input_size * _num_players);
 	for (u8 i = 0; i < _num_players; i++) {
-		auto inp = _input_buffers[i].GetInput(_current_frame, true);
+		auto inp = _input_buffers[i].GetInput(frame, true);
 	
 		if (inp->frame == GameInput::NULL_FRAME) {
 			return false;
 		}
 
-		std::memcpy(all_input.get() + (i * _input_size), (void*)inp->input.get(), _input_size);
+		std::memcpy(_frame_inputs.get() + (i * _input_size), (void*)inp->input.get(), _input_size);
 	}
-	frame = _current_frame;
-	inputs = std::move(all_input);
+	inputs = _frame_inputs.get();
 	return true;
 }
 
-bool Gekko::SyncSystem::GetLocalInput(Handle player, std::unique_ptr<u8[]>& input, Frame frame)
-{	
-	auto inp = _input_buffers[player].GetInput(frame);
-	if (inp->frame == GameInput::NULL_FRAME) {	
-		return false;
-	}
-	std::memcpy(input.get(), inp->input.get(), _input_size);
-	return true;
+u8* Gekko::SyncSystem::GetLocalInput(Handle player, Frame frame)
+{
+	return _input_buffers[player].GetInputData(frame);
 }
 
 void Gekko::SyncSystem::SetLocalDelay(Handle player, u8 delay)
@@ -174,3 +191,33 @@ void Gekko::SyncSystem::ClearIncorrectFramesUpTo(Frame clear_limit)
     }
 }
 
+void Gekko::SyncSystem::TakePredictionCounts(u32& hits, u32& misses)
+{
+    hits = 0;
+    misses = 0;
+    for (i32 i = 0; i < _num_players; i++) {
+        u32 player_hits = 0;
+        u32 player_misses = 0;
+        _input_buffers[i].TakePredictionCounts(player_hits, player_misses);
+        hits += player_hits;
+        misses += player_misses;
+    }
+}
+
+void Gekko::SyncSystem::RepeatLocalInput(Handle player, Frame up_to)
+{
+    if (player >= _num_players || player < 0) {
+        return;
+    }
+
+    _input_buffers[player].RepeatLastInput(up_to);
+}
+
+void Gekko::SyncSystem::PadLocalInput(Handle player, Frame up_to)
+{
+    if (player >= _num_players || player < 0) {
+        return;
+    }
+
+    _input_buffers[player].PadEmptyInput(up_to);
+}
@@ -0,0 +1,367 @@
+#include "timing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+    // half a frame ahead slows the tick rate down by a percent right away,
+    // the integrator takes out what remains of a steady clock difference.
+    constexpr f32 KP = 0.02f;
+    constexpr f32 KI = 0.0002f;
+
+    // how quickly the applied rate follows the loop, keeps the changes gradual.
+    constexpr f32 SLEW_RATE = 0.1f;
+
+    // intervals before the frame time estimate switches to a slow moving average.
+    constexpr u32 WARMUP_INTERVALS = 8;
+    constexpr f32 FRAME_TIME_SMOOTHING = 1.f / 32.f;
+
+    // below this share of failed predictions the latency alone is no reason to add delay.
+    constexpr f32 MIN_MISS_RATE = 0.05f;
+
+    // how far past the target the rollbacks have to go before adding a frame.
+    constexpr f32 GROW_MARGIN = 0.5f;
+
+    // share of the budget the slowest update may use with the extra advance before raising the runahead.
+    constexpr f32 RUNAHEAD_HEADROOM = 0.75f;
+
+    // above this share of failed predictions the frames ran ahead are mostly wrong, runahead is lowered.
+    // it is raised again once they fail at most half as often.
+    constexpr f32 MAX_RUNAHEAD_MISS_RATE = 0.3f;
+
+    constexpr f32 ADVANCE_COST_SMOOTHING = 1.f / 8.f;
+
+    // frames kept in the prediction window beyond the measured latency.
+    constexpr u8 WINDOW_SPARE = 1;
+}
+
+void Gekko::TimeSync::Init()
+{
+    _frame_time_us = DEFAULT_FRAME_TIME_US;
+    _last_update_us = 0;
+    _scale = 1.f;
+    _integrator = 0.f;
+    _frames_ahead = 0.f;
+    _num_intervals = 0;
+}
+
+void Gekko::TimeSync::OnUpdate(u64 now_us)
+{
+    if (_last_update_us != 0 && now_us > _last_update_us) {
+        // the game stretched the frame by the advised scale, take that out again.
+        const f32 nominal = (f32)(now_us - _last_update_us) * _scale;
+
+        if (_num_intervals < WARMUP_INTERVALS) {
+            _num_intervals++;
+            _frame_time_us += (nominal - _frame_time_us) / (f32)_num_intervals;
+        }
+        else if (nominal < _frame_time_us * 4.f) {
+            // anything longer is a hitch like a loading screen, not the frame rate.
+            _frame_time_us += (nominal - _frame_time_us) * FRAME_TIME_SMOOTHING;
+        }
+    }
+
+    _last_update_us = now_us;
+}
+
+u8 Gekko::TimeSync::GetFramePhase(u64 now_us) const
+{
+    if (_last_update_us == 0 || now_us <= _last_update_us) {
+        return 0;
+    }
+
+    const f32 progress = (f32)(now_us - _last_update_us) * _scale / _frame_time_us;
+    return (u8)std::clamp(progress * 256.f, 0.f, 255.f);
+}
+
+void Gekko::TimeSync::Update(f32 frames_ahead, f32 rtt_ms)
+{
+    _frames_ahead = frames_ahead;
+
+    // the advantage is measured a round trip late, lower the gain on slow connections so the loop doesnt overshoot.
+    const f32 gain = 1.f / (1.f + rtt_ms / 100.f);
+
+    _integrator = std::clamp(_integrator + KI * gain * frames_ahead, -MAX_SLEW, MAX_SLEW);
+
+    const f32 correction = std::clamp(KP * gain * frames_ahead + _integrator, -MAX_SLEW, MAX_SLEW);
+    const f32 target = 1.f - correction;
+
+    _scale += (target - _scale) * SLEW_RATE;
+}
+
+void Gekko::TimeSync::GetAdvice(u64 now_us, GekkoTimingAdvice* advice) const
+{
+    const f32 frame_time = _frame_time_us / _scale;
+
+    advice->frame_time_us = (u32)frame_time;
+    advice->tick_rate_scale = _scale;
+    advice->frames_ahead = _frames_ahead;
+
+    if (_last_update_us == 0) {
+        advice->next_tick_us = 0;
+        return;
+    }
+
+    const u64 next = _last_update_us + (u64)frame_time;
+    advice->next_tick_us = next > now_us ? (u32)(next - now_us) : 0;
+}
+
+f32 Gekko::TimeSync::GetFrameTime() const
+{
+    return _frame_time_us;
+}
+
+u64 Gekko::TimeSync::Now()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void Gekko::DelayController::Init(GekkoAdaptiveDelay* settings)
+{
+    _active = true;
+    _settings = *settings;
+    _settings.max_delay = std::max(_settings.min_delay, _settings.max_delay);
+
+    _frames = 0;
+    _hits = 0;
+    _misses = 0;
+    _rollbacks = 0;
+    _rollback_frames = 0;
+    _votes = 0;
+}
+
+void Gekko::DelayController::Disable()
+{
+    _active = false;
+}
+
+bool Gekko::DelayController::IsActive() const
+{
+    return _active;
+}
+
+void Gekko::DelayController::AddRollback(u32 depth)
+{
+    _rollbacks++;
+    _rollback_frames += depth;
+}
+
+u8 Gekko::DelayController::Update(u8 delay, u32 hits, u32 misses, f32 rtt_ms, f32 jitter_ms, f32 frame_time_ms)
+{
+    _hits += hits;
+    _misses += misses;
+
+    // always stay within the bounds, even between evaluations.
+    const u8 bounded = std::clamp(delay, _settings.min_delay, _settings.max_delay);
+
+    if (++_frames < EVAL_INTERVAL) {
+        return bounded;
+    }
+
+    const u32 predictions = _hits + _misses;
+    const f32 miss_rate = predictions > 0 ? (f32)_misses / (f32)predictions : 0.f;
+    const f32 observed = _rollbacks > 0 ? (f32)_rollback_frames / (f32)_rollbacks : 0.f;
+
+    // frames the remote inputs take to arrive, the delay covers the first of them.
+    const f32 latency = (rtt_ms / 2.f + jitter_ms) / std::max(frame_time_ms, 1.f);
+    const f32 expected = latency - (f32)bounded;
+
+    _frames = 0;
+    _hits = 0;
+    _misses = 0;
+    _rollbacks = 0;
+    _rollback_frames = 0;
+
+    // predictions that hold dont roll back, so only grow on the latency when they fail often enough.
+    // shrinking always looks at it so a quiet interval doesnt take away a frame the link still needs.
+    const f32 grow_depth = miss_rate > MIN_MISS_RATE ? std::max(expected, observed) : observed;
+    const f32 shrink_depth = std::max(expected, observed);
+    const f32 target = (f32)_settings.target_rollback;
+
+    if (grow_depth > target + GROW_MARGIN && bounded < _settings.max_delay) {
+        _votes = std::max(_votes, 0) + 1;
+    }
+    else if (shrink_depth + 1.f <= target && bounded > _settings.min_delay) {
+        _votes = std::min(_votes, 0) - 1;
+    }
+    else {
+        _votes = 0;
+    }
+
+    if (_votes >= (i32)GROW_VOTES) {
+        _votes = 0;
+        return bounded + 1;
+    }
+
+    if (_votes <= -(i32)SHRINK_VOTES) {
+        _votes = 0;
+        return bounded - 1;
+    }
+
+    return bounded;
+}
+
+void Gekko::RunaheadController::Init(GekkoAdaptiveRunahead* settings)
+{
+    _active = true;
+    _settings = *settings;
+
+    _updates = 0;
+    _samples = 0;
+    _hits = 0;
+    _misses = 0;
+    _peak_us = 0;
+    _advance_us = 0.f;
+    _votes = 0;
+}
+
+void Gekko::RunaheadController::Disable()
+{
+    _active = false;
+}
+
+bool Gekko::RunaheadController::IsActive() const
+{
+    return _active;
+}
+
+u8 Gekko::RunaheadController::GetMaxRunahead() const
+{
+    return _active ? _settings.max_runahead : 0;
+}
+
+void Gekko::RunaheadController::AddSample(u32 time_us, u32 advances)
+{
+    _samples++;
+    _peak_us = std::max(_peak_us, time_us);
+
+    if (advances == 0) {
+        return;
+    }
+
+    const f32 cost = (f32)time_us / (f32)advances;
+    _advance_us = _advance_us == 0.f ? cost : _advance_us + (cost - _advance_us) * ADVANCE_COST_SMOOTHING;
+}
+
+u8 Gekko::RunaheadController::Update(u8 runahead, u32 hits, u32 misses)
+{
+    _hits += hits;
+    _misses += misses;
+
+    const u8 bounded = std::min(runahead, _settings.max_runahead);
+
+    if (++_updates < EVAL_INTERVAL) {
+        return bounded;
+    }
+
+    const u32 predictions = _hits + _misses;
+    const f32 miss_rate = predictions > 0 ? (f32)_misses / (f32)predictions : 0.f;
+    const u32 samples = _samples;
+    const f32 peak = (f32)_peak_us;
+
+    _updates = 0;
+    _samples = 0;
+    _hits = 0;
+    _misses = 0;
+    _peak_us = 0;
+
+    // without a measured cost theres nothing to go by, keep what was set.
+    if (samples == 0) {
+        _votes = 0;
+        return bounded;
+    }
+
+    const f32 budget = (f32)_settings.frame_budget_us;
+
+    if (bounded > 0 && (peak > budget || miss_rate > MAX_RUNAHEAD_MISS_RATE)) {
+        _votes = 0;
+        return bounded - 1;
+    }
+
+    // every frame of runahead costs an extra advance on each update.
+    const bool headroom = peak + _advance_us <= budget * RUNAHEAD_HEADROOM;
+    const bool accurate = miss_rate <= MAX_RUNAHEAD_MISS_RATE * 0.5f;
+
+    if (bounded >= _settings.max_runahead || !headroom || !accurate) {
+        _votes = 0;
+        return bounded;
+    }
+
+    if (++_votes < RAISE_VOTES) {
+        return bounded;
+    }
+
+    _votes = 0;
+    return bounded + 1;
+}
+
+void Gekko::WindowController::Init(GekkoAdaptivePredictionWindow* settings)
+{
+    _active = true;
+    _settings = *settings;
+
+    // a window of 0 is lockstep which cant be switched to while running.
+    _settings.min_window = std::max<u8>(_settings.min_window, 1);
+    _settings.max_window = std::max(_settings.min_window, _settings.max_window);
+
+    _frames = 0;
+    _stalls = 0;
+    _votes = 0;
+}
+
+void Gekko::WindowController::Disable()
+{
+    _active = false;
+}
+
+bool Gekko::WindowController::IsActive() const
+{
+    return _active;
+}
+
+void Gekko::WindowController::AddStall()
+{
+    _stalls++;
+}
+
+u8 Gekko::WindowController::Update(u8 window, u8 delay, f32 rtt_ms, f32 jitter_ms, f32 frame_time_ms)
+{
+    const u8 bounded = std::clamp(window, _settings.min_window, _settings.max_window);
+
+    if (++_frames < EVAL_INTERVAL) {
+        return bounded;
+    }
+
+    const u32 stalls = _stalls;
+    _frames = 0;
+    _stalls = 0;
+
+    // the remote inputs arrive after half a round trip, allow for twice the jitter on top.
+    const f32 latency = (rtt_ms / 2.f + jitter_ms * 2.f) / std::max(frame_time_ms, 1.f);
+    const i32 needed = (i32)std::ceil(latency) - delay + WINDOW_SPARE;
+    const u8 target = (u8)std::clamp<i32>(needed, _settings.min_window, _settings.max_window);
+
+    if (stalls > 0 && bounded < _settings.max_window) {
+        _votes = 0;
+        return std::max<u8>(bounded + 1, target);
+    }
+
+    if (target > bounded) {
+        _votes = 0;
+        return target;
+    }
+
+    if (target == bounded || stalls > 0) {
+        _votes = 0;
+        return bounded;
+    }
+
+    if (++_votes < SHRINK_VOTES) {
+        return bounded;
+    }
+
+    _votes = 0;
+    return bounded - 1;
+}